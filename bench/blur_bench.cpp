@@ -0,0 +1,79 @@
+// Compares the blur strategies of blurFrame: throughput per frame and error against an exact Gaussian.
+// Usage: ./BlurBench [iterations]
+#include "video_processing.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Deterministic test frame with gradients, edges and fine noise
+static cv::Mat makeTestFrame(const cv::Size& size) {
+    cv::Mat frame(size, CV_8UC3);
+    unsigned int state = 12345;
+    for (int y = 0; y < frame.rows; y++) {
+        cv::Vec3b* row = frame.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            state = state * 1103515245u + 12345u;
+            int noise = static_cast<int>((state >> 16) & 0x1F);
+            bool checker = ((x / 64) + (y / 64)) % 2 == 0;
+            row[x][0] = cv::saturate_cast<uchar>(x * 255 / frame.cols + noise);
+            row[x][1] = cv::saturate_cast<uchar>(y * 255 / frame.rows + noise);
+            row[x][2] = cv::saturate_cast<uchar>((checker ? 200 : 40) + noise);
+        }
+    }
+    return frame;
+}
+
+static const char* methodName(BlurMethod method) {
+    switch (method) {
+        case BlurMethod::Gaussian:
+            return "gaussian";
+        case BlurMethod::Box:
+            return "box";
+        case BlurMethod::Downscaled:
+            return "downscaled";
+        default:
+            return "auto";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    const cv::Size sizes[] = {cv::Size(1920, 1080), cv::Size(3840, 2160)};
+    const int radii[] = {3, 7, 15, 31, 63};
+    const BlurMethod methods[] = {BlurMethod::Gaussian, BlurMethod::Box, BlurMethod::Downscaled};
+
+    std::cout << "resolution,radius,method,ms_per_frame,fps,max_abs_error,psnr_db" << std::endl;
+    for (const cv::Size& size : sizes) {
+        cv::Mat frame = makeTestFrame(size);
+        for (int radius : radii) {
+            // The exact Gaussian of this radius is the reference; radius 7 is what applyBlur always produced
+            cv::Mat reference;
+            cv::GaussianBlur(frame, reference, cv::Size(2 * radius + 1, 2 * radius + 1), 0);
+
+            for (BlurMethod method : methods) {
+                cv::Mat output;
+                blurFrame(frame, output, radius, method);  // Warm-up, also allocates output
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++) {
+                    blurFrame(frame, output, radius, method);
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                double msPerFrame = elapsed.count() / iterations;
+
+                double maxError = cv::norm(output, reference, cv::NORM_INF);
+                double psnr = cv::PSNR(output, reference);
+
+                std::cout << size.width << "x" << size.height << "," << radius << "," << methodName(method) << ","
+                          << std::fixed << std::setprecision(3) << msPerFrame << "," << std::setprecision(1) << 1000.0 / msPerFrame << ","
+                          << std::setprecision(0) << maxError << "," << std::setprecision(2) << psnr << std::endl;
+                std::cout.unsetf(std::ios::fixed);
+            }
+        }
+    }
+    return 0;
+}
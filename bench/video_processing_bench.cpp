@@ -0,0 +1,283 @@
+// End-to-end benchmark of the video operations on generated test videos. For every video and operation it
+// reports decode/transform/encode time of a serial pass, the throughput of the threaded pipeline and of the
+// standalone function from video_processing.cpp, frame pool allocations and the peak RSS of the operation's
+// own process, as CSV. Operations that fail get a "failed" row and the run continues.
+// Usage: ./VideoProcessingBench [frames] [work directory]
+#include "batch_runner.h"
+#include "frame_pipeline.h"
+#include "frame_pool.h"
+#include "video_processing.h"
+#include <opencv2/opencv.hpp>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct VideoSpec {
+    cv::Size size;
+    double fps;
+};
+
+// One benchmarked operation: its chain for the pipeline and the standalone function doing the same
+struct Operation {
+    std::string name;
+    std::string chain;
+    std::function<void(const std::string& inputPath, const std::string& outputPath, int codec)> standalone;
+};
+
+// Time split of a serial decode -> transform -> encode pass
+struct StageTimes {
+    int frames = 0;
+    double decodeMs = 0;
+    double transformMs = 0;
+    double encodeMs = 0;
+};
+
+static double millisecondsSince(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Peak resident set size of the process so far, main runs each operation in a fresh process
+static long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;  // Kilobytes on Linux
+}
+
+// Deterministic test video: a moving gradient, a bouncing box and per-frame noise from a fixed seed
+static bool generateVideo(const std::string& path, const VideoSpec& spec, int frameCount) {
+    cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), spec.fps, spec.size);
+    if (!writer.isOpened()) {
+        std::cerr << "Error: Could not create test video " << path << std::endl;
+        return false;
+    }
+
+    cv::Mat frame(spec.size, CV_8UC3);
+    unsigned int state = 12345;
+    int boxSize = spec.size.height / 4;
+    for (int i = 0; i < frameCount; i++) {
+        for (int y = 0; y < frame.rows; y++) {
+            cv::Vec3b* row = frame.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < frame.cols; x++) {
+                state = state * 1103515245u + 12345u;
+                int noise = static_cast<int>((state >> 16) & 0x0F);
+                row[x][0] = cv::saturate_cast<uchar>((x + 4 * i) * 255 / frame.cols + noise);
+                row[x][1] = cv::saturate_cast<uchar>(y * 255 / frame.rows + noise);
+                row[x][2] = cv::saturate_cast<uchar>(128 + noise);
+            }
+        }
+        int travelX = std::max(1, frame.cols - boxSize);
+        int travelY = std::max(1, frame.rows - boxSize);
+        int boxX = (i * 7) % (2 * travelX);
+        int boxY = (i * 5) % (2 * travelY);
+        cv::Rect box(boxX < travelX ? boxX : 2 * travelX - boxX, boxY < travelY ? boxY : 2 * travelY - boxY, boxSize, boxSize);
+        cv::rectangle(frame, box, cv::Scalar(255, 255, 255), cv::FILLED);
+        writer.write(frame);
+    }
+    return true;
+}
+
+// Serial pass over the pipeline's frame range with each phase timed separately
+static bool measureStages(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                          StageTimes& times) {
+    cv::VideoCapture cap(inputPath);
+    if (!cap.isOpened()) {
+        return false;
+    }
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    cv::Size sourceSize(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+
+    int startFrame, endFrame;
+    if (!pipelineFrameRange(pipeline, fps, totalFrames, startFrame, endFrame)) {
+        return false;
+    }
+    auto seekStart = Clock::now();
+    if (startFrame > 0 && !seekToFrame(cap, startFrame)) {
+        return false;
+    }
+    times.decodeMs += millisecondsSince(seekStart);
+
+    cv::VideoWriter writer(outputPath, codec, fps, pipelineOutputSize(pipeline, sourceSize));
+    if (!writer.isOpened()) {
+        return false;
+    }
+
+    std::vector<cv::Mat> buffers(pipeline.stages.size() + 1);
+    for (int frameIndex = startFrame; frameIndex <= endFrame; frameIndex++) {
+        auto decodeStart = Clock::now();
+        if (!cap.read(buffers[0])) {
+            break;
+        }
+        times.decodeMs += millisecondsSince(decodeStart);
+
+        auto transformStart = Clock::now();
+        cv::Mat* current = &buffers[0];
+        double timestamp = fps > 0 ? frameIndex / fps : 0.0;
+        for (size_t i = 0; i < pipeline.stages.size(); i++) {
+            const FrameStage& stage = pipeline.stages[i];
+            if (stage.inPlace) {
+                stage.apply(*current, *current, timestamp);
+                continue;
+            }
+            stage.apply(*current, buffers[i + 1], timestamp);
+            current = &buffers[i + 1];
+        }
+        times.transformMs += millisecondsSince(transformStart);
+
+        auto encodeStart = Clock::now();
+        writer.write(*current);
+        times.encodeMs += millisecondsSince(encodeStart);
+        times.frames++;
+    }
+    return true;
+}
+
+// Runs fn with std::cout discarded, the standalone functions report progress there
+static double timeQuietly(const std::function<void()>& fn) {
+    std::ostringstream discard;
+    std::streambuf* previous = std::cout.rdbuf(discard.rdbuf());
+    auto start = Clock::now();
+    fn();
+    double elapsed = millisecondsSince(start);
+    std::cout.rdbuf(previous);
+    return elapsed;
+}
+
+static double framesPerSecond(int frames, double milliseconds) {
+    return milliseconds > 0 ? frames * 1000.0 / milliseconds : 0.0;
+}
+
+// CSV row of an operation that could not be measured, so the rest of the matrix still runs
+static void printFailedRow(const std::string& resolution, double fps, const std::string& operation, const std::string& reason) {
+    std::string text = reason;
+    std::replace(text.begin(), text.end(), ',', ';');
+    std::cout << resolution << "," << fps << "," << operation << ",failed: " << text << ",,,,,,,,," << std::endl;
+}
+
+// Measures one operation on one video and prints its CSV row, returns false when it failed
+static bool benchmarkOperation(const std::string& inputPath, const std::string& workDir, const std::string& resolution,
+                               const VideoSpec& video, const Operation& operation, const PipelineOptions& threaded, int codec) {
+    FramePipeline pipeline;
+    std::string error;
+    if (!parseOperationChain(operation.chain, pipeline, error)) {
+        printFailedRow(resolution, video.fps, operation.name, error);
+        return false;
+    }
+    std::string outputPath = workDir + "/out_" + resolution + "_" + operation.name + ".avi";
+
+    StageTimes times;
+    if (!measureStages(inputPath, outputPath, pipeline, codec, times)) {
+        printFailedRow(resolution, video.fps, operation.name, "serial pass");
+        return false;
+    }
+    double serialMs = times.decodeMs + times.transformMs + times.encodeMs;
+
+    FramePool pool;
+    PipelineOptions options = threaded;
+    options.framePool = &pool;
+    bool pipelineOk = false;
+    double pipelineMs = timeQuietly([&]() { pipelineOk = runPipeline(inputPath, outputPath, pipeline, codec, options); });
+    FramePoolStats poolStats = pool.stats();
+
+    double standaloneMs = 0;
+    if (operation.standalone) {
+        standaloneMs = timeQuietly([&]() { operation.standalone(inputPath, outputPath, codec); });
+    }
+
+    std::cout << resolution << "," << video.fps << "," << operation.name << "," << times.frames << "," << std::fixed
+              << std::setprecision(2) << times.decodeMs << "," << times.transformMs << "," << times.encodeMs << ","
+              << std::setprecision(1) << framesPerSecond(times.frames, serialMs) << ","
+              << (pipelineOk ? framesPerSecond(times.frames, pipelineMs) : 0.0) << ",";
+    if (operation.standalone) {
+        std::cout << framesPerSecond(times.frames, standaloneMs);
+    }
+    std::cout << "," << poolStats.allocations << "," << poolStats.reuses << "," << peakRssKb() << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::remove(outputPath.c_str());
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int frameCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 120;
+    std::string workDir = argc > 2 ? argv[2] : "bench_videos";
+    mkdir(workDir.c_str(), 0777);
+
+    const VideoSpec videos[] = {{cv::Size(640, 360), 30.0}, {cv::Size(1280, 720), 30.0}, {cv::Size(1920, 1080), 60.0}};
+    const int codec = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+
+    PipelineOptions threaded;
+    threaded.workerThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threaded.verbose = false;
+
+    // peak_rss_kb is per operation: each one runs in its own process, since the peak of a process never goes down
+    std::cout << "resolution,source_fps,operation,frames,decode_ms,transform_ms,encode_ms,serial_fps,pipeline_fps,standalone_fps,"
+                 "pool_allocations,pool_reuses,peak_rss_kb"
+              << std::endl;
+    int failures = 0;
+    for (const VideoSpec& video : videos) {
+        std::string resolution = std::to_string(video.size.width) + "x" + std::to_string(video.size.height);
+        std::string inputPath = workDir + "/synthetic_" + resolution + "_" + std::to_string(static_cast<int>(video.fps)) + ".avi";
+        if (!generateVideo(inputPath, video, frameCount)) {
+            return 1;
+        }
+
+        // The trim window covers the middle half of the clip, whatever its length and frame rate
+        double duration = frameCount / video.fps;
+        double trimStart = duration / 4;
+        double trimEnd = duration * 3 / 4;
+        std::ostringstream trimStream;
+        trimStream << "trim=" << trimStart << ":" << trimEnd;
+        std::string trim = trimStream.str();
+
+        // "all" is the chain of the interactive "Apply all changes" option with the grayscale filter
+        const Operation operations[] = {
+            {"resize", "resize=640x360",
+             [](const std::string& in, const std::string& out, int c) { resizeVideo(in, out, 640, 360, c); }},
+            {"overlay", "text=50,50,Benchmark",
+             [](const std::string& in, const std::string& out, int c) { addTextOverlay(in, out, "Benchmark", 50, 50, c); }},
+            {"trim", trim,
+             [=](const std::string& in, const std::string& out, int c) { trimVideo(in, out, trimStart, trimEnd, c); }},
+            {"rotate", "rotate=90",
+             [](const std::string& in, const std::string& out, int c) { rotateVideo(in, out, 90, c); }},
+            {"rotate-small", "rotate=3.5",
+             [](const std::string& in, const std::string& out, int c) { rotateVideo(in, out, 3.5, c); }},
+            {"grayscale", "grayscale",
+             [](const std::string& in, const std::string& out, int c) { applyGrayscale(in, out, c); }},
+            {"blur", "blur",
+             [](const std::string& in, const std::string& out, int c) { applyBlur(in, out, c); }},
+            {"all", trim + ";text=50,50,Benchmark;resize=640x360;rotate=90;grayscale", nullptr},
+        };
+
+        for (const Operation& operation : operations) {
+            std::cout.flush();
+            pid_t child = fork();
+            if (child == 0) {
+                bool ok = benchmarkOperation(inputPath, workDir, resolution, video, operation, threaded, codec);
+                std::cout.flush();
+                std::_Exit(ok ? 0 : 1);
+            }
+            int status = 0;
+            if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status)) {
+                printFailedRow(resolution, video.fps, operation.name, child < 0 ? "fork" : "crashed");
+                failures++;
+            } else if (WEXITSTATUS(status) != 0) {
+                failures++;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
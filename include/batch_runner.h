@@ -0,0 +1,56 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <string>
+#include <vector>
+#include "frame_pipeline.h"
+#include "result_cache.h"
+#include "thumbnails.h"
+
+// One non-interactive job: an input, an output and the operations to apply
+struct JobSpec {
+    std::string inputPath;
+    std::string outputPath;
+    std::string operations;  // Operation chain as written by the user, see parseOperationChain
+    FramePipeline pipeline;
+    int codec = 0;
+    bool thumbnails = false;  // Writes images with extractThumbnails instead of running the pipeline
+    ThumbnailOptions thumbnailOptions;
+};
+
+// How a list of jobs is run
+struct BatchOptions {
+    int concurrentJobs = 1;    // Jobs processed at the same time
+    int segments = 1;          // More than 1 splits every job into parallel segments
+    PipelineOptions pipeline;  // Options for each job's frame pipeline
+    ResultCache* cache = nullptr;  // Reuses outputs of earlier runs of the same input and chain when set
+    double checkpointSeconds = 0;  // Above 0 makes jobs resumable, with a checkpoint every this many source seconds
+};
+
+// Parses an operation chain such as "trim=2:10;text=50,50,Hello;resize=640x480;rotate=90;grayscale;blur".
+// Operations are separated by ';' and applied in order, trim always cuts the source first.
+// blur also accepts a radius and method, e.g. "blur=31,box". rotate takes any clockwise angle, angles other than
+// multiples of 90 crop to the frame or expand it, e.g. "rotate=3.5" or "rotate=-10,expand".
+// timedtext=START:END,X,Y,TEXT shows text for part of the video and watermark=X,Y,OPACITY,PATH blends an image.
+bool parseOperationChain(const std::string& chain, FramePipeline& pipeline, std::string& error);
+
+// Parses a thumbnail spec "COUNT[,WIDTH|WIDTHxHEIGHT][,even|scene][,sheet|frames]", e.g. "12,160x90,scene"
+bool parseThumbnailSpec(const std::string& spec, ThumbnailOptions& options, std::string& error);
+
+// Codec for an output file, chosen from its extension the same way as the interactive format prompt
+int codecForOutputPath(const std::string& outputPath);
+
+// Builds a job, returns false with a message in error if the operation chain is invalid. A chain made of a
+// single "thumbnails=SPEC" operation makes a thumbnail job whose output is an image.
+bool makeJob(const std::string& inputPath, const std::string& outputPath, const std::string& operations, JobSpec& job, std::string& error);
+
+// Reads a CSV manifest, one "input,output,operations" job per line. Empty lines and lines starting with '#'
+// are skipped, the operations column runs to the end of the line so overlay text may contain commas.
+bool loadManifest(const std::string& manifestPath, std::vector<JobSpec>& jobs, std::string& error);
+
+// Runs every job, prints one status line per job and a summary, returns the number of failed jobs.
+// With a cache, a job whose input contents, chain and codec match an earlier run gets that output without
+// processing, and a job extending an earlier chain continues from its output.
+int runBatch(const std::vector<JobSpec>& jobs, const BatchOptions& options);
+
+#endif
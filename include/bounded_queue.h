@@ -0,0 +1,70 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity ring buffer shared between threads, push blocks while full and pop blocks while empty
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : slots(capacity > 0 ? capacity : 1) {}
+
+    // Returns false if the queue was closed before the item could be added
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || count < slots.size(); });
+        if (closed) {
+            return false;
+        }
+        slots[(head + count) % slots.size()] = std::move(item);
+        count++;
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || count > 0; });
+        if (count == 0) {
+            return false;
+        }
+        item = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        count--;
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes every waiting thread, remaining items can still be popped
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    size_t capacity() const {
+        return slots.size();
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+    bool closed = false;
+    mutable std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+#endif
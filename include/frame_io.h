@@ -0,0 +1,101 @@
+#ifndef FRAME_IO_H
+#define FRAME_IO_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+// Where the frame pipeline reads decoded BGR frames from
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    virtual bool read(cv::Mat& frame) = 0;
+    // Positions the source so the next read returns targetFrame
+    virtual bool seek(int targetFrame) = 0;
+    virtual double fps() const = 0;
+    virtual cv::Size frameSize() const = 0;
+    // Number of frames, 0 when unknown (e.g. a pipe)
+    virtual int frameCount() const = 0;
+};
+
+// Where the frame pipeline writes finished frames to
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+    virtual void write(const cv::Mat& frame) = 0;
+};
+
+// A file or container stream opened with cv::VideoCapture
+class CaptureSource : public FrameSource {
+public:
+    explicit CaptureSource(const std::string& path);
+    bool isOpened() const;
+    bool read(cv::Mat& frame) override;
+    bool seek(int targetFrame) override;
+    double fps() const override;
+    cv::Size frameSize() const override;
+    int frameCount() const override;
+
+private:
+    cv::VideoCapture cap;
+};
+
+// Raw BGR24 frames of a fixed size read back to back from a pipe, e.g. the output of
+// "ffmpeg -i in.mp4 -f rawvideo -pix_fmt bgr24 -"
+class RawPipeSource : public FrameSource {
+public:
+    RawPipeSource(std::FILE* file, const cv::Size& size, double fps);
+    bool read(cv::Mat& frame) override;
+    bool seek(int targetFrame) override;  // Forward only, skipped frames are read and dropped
+    double fps() const override;
+    cv::Size frameSize() const override;
+    int frameCount() const override;
+
+private:
+    std::FILE* file;
+    cv::Size size;
+    double rate;
+    int position = 0;
+    cv::Mat skipped;
+};
+
+// An encoded video file written with cv::VideoWriter
+class WriterSink : public FrameSink {
+public:
+    WriterSink(const std::string& path, int codec, double fps, const cv::Size& size);
+    bool isOpened() const;
+    void write(const cv::Mat& frame) override;
+
+private:
+    cv::VideoWriter writer;
+};
+
+// Raw BGR24 frames written back to back to a pipe and flushed after every frame, so a downstream
+// process sees each frame as soon as it is finished
+class RawPipeSink : public FrameSink {
+public:
+    explicit RawPipeSink(std::FILE* file);
+    void write(const cv::Mat& frame) override;
+
+private:
+    std::FILE* file;
+    cv::Mat converted;
+};
+
+// Format of raw frames arriving on stdin, a zero size means stdin carries a container stream instead
+struct RawVideoFormat {
+    cv::Size size;
+    double fps = 30.0;
+};
+
+// "-" is stdin: raw BGR24 frames when raw.size is set, otherwise a container stream. Anything else is
+// opened with cv::VideoCapture. Returns null with a message on std::cerr if the input cannot be opened.
+std::unique_ptr<FrameSource> openFrameSource(const std::string& path, const RawVideoFormat& raw);
+
+// "-" writes raw BGR24 frames to stdout, anything else is encoded with codec. Returns null with a message on
+// std::cerr if the output cannot be opened.
+std::unique_ptr<FrameSink> openFrameSink(const std::string& path, int codec, double fps, const cv::Size& size);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "frame_io.h"
+#include "overlay.h"
+#include "video_processing.h"
+
+class FramePool;
+class PipelineStats;
+
+// One per-frame operation of a fused pipeline
+struct FrameStage {
+    std::string name;
+    // Writes the transformed frame to output (output is the same Mat as input when inPlace is set).
+    // timestamp is the frame's position in the source in seconds. Must be safe to call from several
+    // worker threads at once.
+    std::function<void(const cv::Mat& input, cv::Mat& output, double timestamp)> apply;
+    // Cheaper approximation of apply used by live mode when it falls behind, empty when there is none
+    std::function<void(const cv::Mat& input, cv::Mat& output, double timestamp)> applyDegraded;
+    // Output frame size for a given input size, empty when the stage keeps the size
+    std::function<cv::Size(const cv::Size& inputSize)> outputSize;
+    bool inPlace = false;
+    bool timeVarying = false;  // Output depends on the timestamp, so identical frames may still need processing
+};
+
+// Chain of stages applied in memory between a single decode and a single encode
+struct FramePipeline {
+    std::vector<FrameStage> stages;
+    double startTime = -1.0;  // Trim window in seconds, negative means the whole video
+    double endTime = -1.0;
+};
+
+// Threading options for runPipeline
+struct PipelineOptions {
+    int workerThreads = 0;           // Transform threads between the decoder and encoder threads, 0 runs serially
+    size_t queueCapacity = 8;        // Frames buffered between each pair of pipeline stages
+    bool verbose = true;             // Print progress messages to std::cout
+    FramePool* framePool = nullptr;  // Frame buffer pool whose counters the caller can inspect, a private one when null
+    double progressInterval = 0;     // Seconds between progress lines on std::cout, 0 disables them
+    std::string statsPath;           // Appends one JSON stats record per run to this file ("-" for std::cout)
+    std::string tracePath;           // Writes a Chrome trace-event file of every decode, stage and encode call
+    RawVideoFormat rawInput;         // Frame size and rate of raw frames when the input path is "-"
+    double unchangedThreshold = -1;  // Frames within this of the last processed one reuse its output, see FrameChangeDetector
+};
+
+// Stage factories built on the frame kernels from video_processing.h and the overlay compositor
+FrameStage makeTextOverlayStage(const std::string& text, int x, int y);
+FrameStage makeOverlayStage(std::shared_ptr<const OverlayCompositor> overlays);
+FrameStage makeResizeStage(int width, int height);
+FrameStage makeRotateStage(double angle, RotateFit fit = RotateFit::Crop);
+FrameStage makeGrayscaleStage();
+FrameStage makeBlurStage(int radius = 7, BlurMethod method = BlurMethod::Auto);
+
+// Frame size produced by the whole pipeline for a given source size
+cv::Size pipelineOutputSize(const FramePipeline& pipeline, const cv::Size& inputSize);
+
+// Source frame range covered by the pipeline's trim window (the whole video when there is none)
+bool pipelineFrameRange(const FramePipeline& pipeline, double fps, int totalFrames, int& startFrame, int& endFrame);
+
+// Stats phase names of a pipeline run: "decode", each stage name in order, then "encode"
+std::vector<std::string> pipelinePhaseNames(const FramePipeline& pipeline);
+
+// Runs every stage on buffers[0] and returns the buffer holding the final frame. buffers holds one Mat per
+// stage plus one; stage outputs come from the pool and are reused for every later frame of the same size.
+// degraded runs each stage's applyDegraded where it has one.
+cv::Mat& applyPipelineStages(const FramePipeline& pipeline, std::vector<cv::Mat>& buffers, FramePool& pool, double timestamp,
+                             PipelineStats& stats, bool degraded = false);
+
+// Decodes the input once, applies every stage to each frame inside the trim window and encodes once.
+// With worker threads the output is identical to the serial run, frames are written back in decode order.
+// Either path may be "-" to stream through stdin or stdout, see openFrameSource and openFrameSink.
+bool runPipeline(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                 const PipelineOptions& options = PipelineOptions());
+
+// Runs the pipeline over source frames startFrame..endFrame (inclusive), ignoring the pipeline's trim window
+bool runPipelineFrames(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                       int startFrame, int endFrame, const PipelineOptions& options = PipelineOptions());
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Allocation counters of a FramePool
+struct FramePoolStats {
+    size_t allocations = 0;    // Buffers the pool had to allocate
+    size_t reuses = 0;         // Requests served from a returned buffer
+    size_t reallocations = 0;  // Pooled buffers a stage or the decoder replaced with its own allocation
+};
+
+// Reusable frame buffers kept per resolution and type, shared safely between threads.
+// In steady state a pipeline acquires nothing, so allocations and reallocations stop growing.
+class FramePool {
+public:
+    // Returns a buffer with the given size and type, allocating only when none is free
+    cv::Mat acquire(const cv::Size& size, int type);
+
+    // Hands a buffer back for reuse, frame is left empty
+    void release(cv::Mat& frame);
+
+    // Records that a pooled buffer was reallocated outside the pool
+    void countReallocation();
+
+    FramePoolStats stats() const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::tuple<int, int, int>, std::vector<cv::Mat>> freeFrames;
+    FramePoolStats counters;
+};
+
+#endif
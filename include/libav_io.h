@@ -0,0 +1,53 @@
+#ifndef LIBAV_IO_H
+#define LIBAV_IO_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Helpers that work on compressed packets through libavformat. They are only functional when the
+// project is built with libav (HAVE_LIBAV), otherwise they report failure and callers transcode.
+
+// True if the input's video stream already uses the requested codec and the output container can hold it
+bool canStreamCopy(const std::string& inputPath, const std::string& outputPath, int codec);
+
+// Copies the video packets between startTime and endTime (in seconds, negative for the whole video) into
+// outputPath without re-encoding. Fails and removes the partial output when the start is not on a keyframe,
+// or when the source has B-frames and the frame after the end is not a keyframe.
+bool streamCopyVideo(const std::string& inputPath, const std::string& outputPath, double startTime, double endTime);
+
+// Source frame numbers of all video keyframes, read from packet flags without decoding, which reads every
+// packet of the file. Empty if unavailable.
+std::vector<int> buildKeyframeIndex(const std::string& inputPath);
+
+// For each frame number, the keyframe at or before it, found by seeking through the container's index and
+// reading one packet, so the cost does not grow with the file. Empty if unavailable.
+std::vector<int> keyframesAtOrBefore(const std::string& inputPath, const std::vector<int>& frames);
+
+// Whether the video stream's luma spans the full 0-255 range (JPEG, yuvj formats) rather than 16-235.
+// Returns false if the stream cannot be read.
+bool videoFullRange(const std::string& inputPath, bool& fullRange);
+
+// Joins videos that share codec parameters (e.g. segments written by the same encoder settings) by copying
+// their packets back to back into outputPath
+bool concatVideos(const std::vector<std::string>& inputPaths, const std::string& outputPath);
+
+// Decodes a video straight to a smaller BGR size. The decoder's reduced-resolution mode is used when it has
+// one and the rest of the scaling happens during the YUV to BGR conversion, so full-size BGR frames never
+// exist. open fails without libav or for streams that need rotating, callers then use cv::VideoCapture.
+class ScaledDecoder {
+public:
+    ScaledDecoder();
+    ~ScaledDecoder();
+
+    bool open(const std::string& inputPath, const cv::Size& outputSize);
+    bool read(cv::Mat& frame);
+    double fps() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+#endif
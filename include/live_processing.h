@@ -0,0 +1,32 @@
+#ifndef LIVE_PROCESSING_H
+#define LIVE_PROCESSING_H
+
+#include <string>
+#include "frame_pipeline.h"
+
+// What live mode does with frames once processing falls behind the source
+enum class DropPolicy {
+    DropOldest,      // Discard the oldest waiting frames so the newest is processed next
+    SkipProcessing,  // Repeat the last finished frame instead of processing until the backlog clears, or drop the
+                     // frame when the encoder is what falls behind
+    LowerQuality     // Run the stages' cheaper degraded variants until the backlog clears
+};
+
+struct LiveOptions {
+    DropPolicy dropPolicy = DropPolicy::DropOldest;
+    size_t maxQueuedFrames = 2;    // Frames waiting for processing beyond which the source counts as ahead
+    bool realTime = false;         // Deliver a file's frames at its own frame rate, as a camera would
+    double duration = 0;           // Stop after this many seconds, 0 runs until the source ends or Ctrl+C
+    double reportInterval = 5.0;   // Seconds between status lines, 0 disables them
+    std::string statsPath;         // Appends a JSON stats record when the run ends ("-" for std::cout)
+};
+
+// Processes a live source: a camera index such as "0", a stream URL (rtsp://, http://, a v4l2 device path)
+// or a file, replayed at real-time rate when options.realTime is set. Capture runs on its own thread and
+// never waits for processing, so latency stays bounded by maxQueuedFrames and the drop policy. Reports the
+// capture-to-written latency and how many frames were dropped, skipped or degraded. The pipeline's trim
+// window does not apply, use options.duration to bound the run.
+bool runLive(const std::string& source, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+             const LiveOptions& options);
+
+#endif
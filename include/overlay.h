@@ -0,0 +1,44 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// An overlay rendered once: its colour pixels and coverage, limited to its bounding rectangle
+struct OverlayLayer {
+    cv::Rect rect;            // Position and size in frame coordinates
+    cv::Mat color;            // CV_8UC3 pixels of the rectangle
+    cv::Mat mask;             // CV_8UC1 coverage, used when the layer is fully opaque where it is drawn
+    cv::Mat inverseAlpha;     // CV_8UC3 255 - coverage per channel, used for blending otherwise
+    cv::Mat weightedColor;    // CV_8UC3 color * coverage / 255, the layer's share of a blended pixel
+    bool opaque = true;       // Coverage is only ever 0 or 255
+    double startTime = -1.0;  // Visible between startTime and endTime in seconds, negative for always
+    double endTime = -1.0;
+};
+
+// Text and image overlays pre-rendered into cached layers and composited onto each frame. Only the layer
+// rectangles are touched, so the per-frame cost follows the overlay area rather than glyph rasterisation.
+class OverlayCompositor {
+public:
+    // Text drawn like addTextOverlay always has (red FONT_HERSHEY_SIMPLEX, scale 1, thickness 3) with its
+    // baseline starting at (x, y)
+    void addText(const std::string& text, int x, int y, double startTime = -1.0, double endTime = -1.0);
+
+    // Image watermark with its top-left corner at (x, y). A 4-channel image's alpha is respected and scaled
+    // by opacity. Returns false if the image cannot be read.
+    bool addImage(const std::string& imagePath, int x, int y, double opacity = 1.0, double startTime = -1.0, double endTime = -1.0);
+
+    // Composites every layer visible at timestamp (seconds) onto a BGR frame
+    void apply(cv::Mat& frame, double timestamp) const;
+
+    // True if any layer is only shown for part of the video
+    bool isTimed() const;
+
+    bool empty() const;
+
+private:
+    std::vector<OverlayLayer> layers;
+};
+
+#endif
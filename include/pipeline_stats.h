@@ -0,0 +1,95 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Latency summary of one phase (decode, a stage or encode) in milliseconds
+struct PhaseSummary {
+    std::string name;
+    size_t count = 0;
+    double totalMs = 0;
+    double meanMs = 0;
+    double p50Ms = 0;
+    double p90Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+};
+
+// Occupancy of a queue between pipeline threads, sampled each time a frame is decoded
+struct QueueSummary {
+    size_t capacity = 0;
+    double mean = 0;
+    size_t max = 0;
+};
+
+// Timings of one pipeline run: per-phase latencies, queue depths and progress. Phases and queues are
+// recorded from any thread; progress is reported by the thread that writes frames.
+class PipelineStats {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // phaseNames are fixed for the run, expectedFrames is 0 when the length is unknown and runLabel names the
+    // run in progress lines. Chrome trace events are only kept when keepTrace is set.
+    PipelineStats(const std::vector<std::string>& phaseNames, int expectedFrames, const std::string& runLabel, bool keepTrace);
+
+    void recordPhase(size_t phase, const Clock::time_point& start, const Clock::time_point& end);
+    void sampleQueues(size_t decodedDepth, size_t decodedCapacity, size_t processedDepth, size_t processedCapacity);
+
+    // Counts a written frame and prints a progress line when interval seconds have passed since the last one
+    void frameWritten(double interval);
+
+    int framesWritten() const;
+    double elapsedSeconds() const;
+    std::vector<PhaseSummary> phaseSummaries() const;
+
+    // Final record as one line of JSON. extraFields is inserted as is, e.g. "\"input\":\"a.mp4\","
+    void writeJson(std::ostream& out, const std::string& extraFields) const;
+
+    // Chrome trace-event file, open with chrome://tracing or Perfetto
+    bool writeTrace(const std::string& path) const;
+
+private:
+    struct TraceEvent {
+        size_t phase;
+        int thread;
+        double startUs;
+        double durationUs;
+    };
+
+    int threadNumber();
+    void printProgress(int frames) const;
+
+    std::vector<std::string> names;
+    int expected;
+    std::string label;
+    bool trace;
+    Clock::time_point startTime;
+
+    mutable std::mutex mutex;
+    std::vector<std::vector<float>> samples;  // Per-phase latencies in milliseconds
+    std::vector<TraceEvent> events;
+    std::map<std::thread::id, int> threads;
+    QueueSummary decodedQueue, processedQueue;
+    size_t queueSamples = 0;
+    double decodedSum = 0, processedSum = 0;
+
+    std::atomic<int> written;
+    Clock::time_point lastProgress;
+};
+
+// Appends the final JSON record of a run to statsPath ("-" for std::cout). Runs from concurrent batch
+// jobs may share the file.
+void appendStatsRecord(const PipelineStats& stats, const std::string& statsPath, const std::string& extraFields);
+
+// Escapes a string for use inside a JSON string literal
+std::string jsonEscape(const std::string& text);
+
+#endif
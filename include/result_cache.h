@@ -0,0 +1,61 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+// Counters of a ResultCache
+struct CacheStats {
+    size_t hits = 0;          // Jobs answered with a cached output
+    size_t prefixHits = 0;    // Jobs that started from the cached output of a leading part of their chain
+    size_t misses = 0;        // Jobs processed from scratch
+    size_t stores = 0;        // Outputs added to the cache
+    size_t evictions = 0;     // Entries removed to stay under the size limit
+};
+
+// 64-bit FNV-1a, seed continues a previous hash
+uint64_t fnv1a(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+// On-disk cache of job outputs in one directory, keyed by the input file's content hash, the operation chain
+// and the codec. Entries are files named after their key; their modification time records the last use and
+// the least recently used ones are evicted once the directory exceeds its size limit. Safe to share between
+// concurrent jobs.
+class ResultCache {
+public:
+    ResultCache(const std::string& directory, uint64_t maxBytes);
+
+    // Hex FNV-1a hash of a file's contents, remembered per path, size and modification time. Empty on error.
+    std::string fileDigest(const std::string& path);
+
+    // Entry key for an output of the chain applied to the input with the given content digest
+    std::string key(const std::string& inputDigest, const std::string& chain, int codec, const std::string& extension) const;
+
+    bool contains(const std::string& key, const std::string& extension) const;
+
+    // Copies the cached entry to outputPath and marks it used
+    bool fetch(const std::string& key, const std::string& extension, const std::string& outputPath);
+
+    // Adds a finished output to the cache, then evicts least recently used entries over the limit
+    bool store(const std::string& key, const std::string& extension, const std::string& resultPath);
+
+    void countHit();
+    void countPrefixHit();
+    void countMiss();
+    CacheStats stats() const;
+
+private:
+    std::string entryPath(const std::string& key, const std::string& extension) const;
+    void evict();
+
+    std::string directory;
+    uint64_t maxBytes;
+
+    mutable std::mutex mutex;
+    std::map<std::tuple<std::string, uint64_t, int64_t>, std::string> digests;  // (path, size, mtime) -> digest
+    CacheStats counters;
+};
+
+#endif
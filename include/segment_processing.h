@@ -0,0 +1,48 @@
+#ifndef SEGMENT_PROCESSING_H
+#define SEGMENT_PROCESSING_H
+
+#include <string>
+#include <vector>
+#include "frame_pipeline.h"
+
+// Inclusive range of source frames
+struct FrameRange {
+    int start = 0;
+    int end = 0;
+};
+
+// Splits startFrame..endFrame into up to segmentCount ranges, moving each boundary onto the next keyframe
+// when a keyframe index is given
+std::vector<FrameRange> planSegments(int startFrame, int endFrame, int segmentCount, const std::vector<int>& keyframes);
+
+// Temporary file for one segment next to the output, e.g. final.mp4 -> final.part2.mp4
+std::string segmentPath(const std::string& outputPath, int index);
+
+// Joins segment files into outputPath, copying packets when possible and re-encoding with codec otherwise
+bool joinSegments(const std::vector<std::string>& segmentPaths, const std::string& outputPath, int codec);
+
+// Processes keyframe-aligned segments of the input on a bounded set of threads, each segment with its own
+// capture and writer, then joins them into outputPath. Every segment runs with options, minus progress
+// messages and the trace file. Standard input or output falls back to a single runPipeline.
+bool runPipelineSegmented(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                          int segmentCount, const PipelineOptions& options = PipelineOptions());
+
+// How a resumable run checkpoints its progress
+struct ResumeOptions {
+    double checkpointSeconds = 30.0;  // Source seconds per segment, each finished segment is a checkpoint
+    int parallelSegments = 1;         // Segments processed at the same time
+    std::string signature;            // Describes the operations, a checkpoint left by different operations is discarded
+    PipelineOptions pipeline;         // Options for each segment's pipeline
+};
+
+// Work directory holding the segments and checkpoint of a resumable run, e.g. final.mp4 -> final.mp4.resume
+std::string resumeDirectory(const std::string& outputPath);
+
+// Processes the input as keyframe-aligned segments written to resumeDirectory(outputPath), recording each
+// finished segment in a checkpoint file there. A run restarted after being killed with the same input, operations,
+// codec and checkpoint interval only processes the segments the checkpoint does not list. The segments are joined
+// into outputPath and the work directory is removed once the output is complete.
+bool runPipelineResumable(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                          const ResumeOptions& options);
+
+#endif
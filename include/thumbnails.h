@@ -0,0 +1,34 @@
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// How thumbnail frames are chosen
+enum class ThumbnailSelection {
+    Even,        // Evenly spaced over the video
+    SceneChange  // Candidates with the largest change from the previous candidate
+};
+
+struct ThumbnailOptions {
+    int count = 9;
+    int width = 320;                      // Width of each thumbnail
+    int height = 0;                       // Height of each thumbnail, 0 keeps the source aspect ratio
+    ThumbnailSelection selection = ThumbnailSelection::Even;
+    bool contactSheet = true;             // One tiled image, otherwise one image per thumbnail
+    int columns = 0;                      // Contact sheet columns, 0 for a roughly square grid
+};
+
+// Frame numbers of count evenly spaced frames, each listed once when count exceeds totalFrames
+std::vector<int> selectEvenFrames(int totalFrames, int count);
+
+// Path of the index-th image when thumbnails are written separately, e.g. thumbs.jpg -> thumbs_03.jpg
+std::string thumbnailPath(const std::string& outputPath, int index);
+
+// Seeks to a handful of frames, resizes them and writes a contact sheet to outputPath (any format cv::imwrite
+// supports) or individual images next to it. Only the chosen frames (or a few candidates per thumbnail in
+// SceneChange mode) are decoded.
+bool extractThumbnails(const std::string& inputPath, const std::string& outputPath, const ThumbnailOptions& options);
+
+#endif
@@ -2,13 +2,79 @@
 #define VIDEO_PROCESSING_H
 
 #include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+// Blur strategies, Auto picks one by radius (Gaussian up to 7, Box up to 25, Downscaled above)
+enum class BlurMethod {
+    Auto,
+    Gaussian,    // Exact separable Gaussian, cost grows with the radius
+    Box,         // Three running-sum box passes approximating the Gaussian, cost independent of the radius
+    Downscaled   // Gaussian on a reduced copy that is scaled back up, for very large radii
+};
+
+// How a rotation by an angle other than a multiple of 90 degrees fits the rotated picture into the frame
+enum class RotateFit {
+    Crop,    // Keep the frame size and zoom in just enough that no empty corners show
+    Expand   // Grow the frame to hold the whole rotated picture, corners filled with black
+};
+
+// Coordinate maps of an arbitrary-angle rotation for one input size, built once and applied to every frame
+// with a single remap. Fixed-point maps (CV_16SC2 coordinates plus CV_16UC1 interpolation weights) take half
+// the memory traffic of float maps.
+struct RotationMaps {
+    cv::Size inputSize;
+    cv::Size outputSize;
+    cv::Mat coordinates;
+    cv::Mat weights;
+};
 
 // Functions declarations 
 void resizeVideo(const std::string& inputPath, const std::string& outputPath, int width, int height, int codec);
 void addTextOverlay(const std::string &inputPath, const std::string &outputPath, const std::string &text, int x, int y, int codec);
 void trimVideo(const std::string& inputPath, const std::string& outputPath, double startTime, double endTime, int codec);
-void rotateVideo(const std::string& inputPath, const std::string& outputPath, int angle, int codec);
+void rotateVideo(const std::string& inputPath, const std::string& outputPath, double angle, int codec, RotateFit fit = RotateFit::Crop);
 void applyGrayscale(const std::string& inputPath, const std::string& outputPath, int codec);
-void applyBlur(const std::string& inputPath, const std::string& outputPath, int codec);
+void applyBlur(const std::string& inputPath, const std::string& outputPath, int codec, int radius = 7, BlurMethod method = BlurMethod::Auto);
+
+
+// Per-frame kernels shared by the functions above and the frame pipeline
+void resizeFrame(const cv::Mat& input, cv::Mat& output, int width, int height);
+bool rotateFrame(const cv::Mat& input, cv::Mat& output, int angle);
+void grayscaleFrame(const cv::Mat& input, cv::Mat& output);
+void blurFrame(const cv::Mat& input, cv::Mat& output, int radius = 7, BlurMethod method = BlurMethod::Auto);
+
+// Arbitrary-angle rotation, clockwise like rotateFrame. fast uses nearest-neighbour sampling.
+RotationMaps buildRotationMaps(const cv::Size& inputSize, double angle, RotateFit fit);
+void rotateFrameWithMaps(const cv::Mat& input, cv::Mat& output, const RotationMaps& maps, bool fast = false);
+
+// Angle in [0, 360)
+double normalizeRotation(double angle);
+
+// Compares frames against the last one that was processed through 16x16 block averages: compression noise
+// averages out, while a small local change such as a moving cursor still shifts its block.
+class FrameChangeDetector {
+public:
+    explicit FrameChangeDetector(double threshold) : threshold(threshold) {}
+
+    // True when no block average differs from the reference by more than threshold (0-255). A changed frame
+    // becomes the new reference.
+    bool unchanged(const cv::Mat& frame);
+
+private:
+    double threshold;
+    cv::Mat reference;
+    cv::Mat current;
+};
+
+// Method Auto resolves to for a radius
+BlurMethod chooseBlurMethod(int radius);
+
+// Positions cap so the next read returns targetFrame. Seeks to the keyframe before the target and decodes
+// forward from there, falling back to decoding from the start when the backend cannot seek accurately.
+bool seekToFrame(cv::VideoCapture& cap, int targetFrame);
+
+// Converts a trim window in seconds to an inclusive frame range, returns false if the window is invalid
+bool trimFrameRange(double fps, int totalFrames, double startTime, double endTime, int& startFrame, int& endFrame);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,442 @@
+#include "batch_runner.h"
+#include "segment_processing.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Splits text on a separator, keeping empty fields
+static std::vector<std::string> splitString(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+static std::string trimWhitespace(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+// Parses "<a><separator><b>" into two numbers
+template <typename T>
+static bool parsePair(const std::string& text, char separator, T& first, T& second) {
+    std::istringstream stream(text);
+    char found = 0;
+    return (stream >> first >> found >> second) && found == separator && stream.eof();
+}
+
+bool parseOperationChain(const std::string& chain, FramePipeline& pipeline, std::string& error) {
+    for (const std::string& rawOperation : splitString(chain, ';')) {
+        std::string operation = trimWhitespace(rawOperation);
+        if (operation.empty()) {
+            continue;
+        }
+
+        size_t equals = operation.find('=');
+        std::string name = operation.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : operation.substr(equals + 1);
+
+        if (name == "trim") {
+            if (!parsePair(value, ':', pipeline.startTime, pipeline.endTime) || pipeline.startTime < 0 || pipeline.startTime >= pipeline.endTime) {
+                error = "invalid trim '" + value + "', expected START:END in seconds";
+                return false;
+            }
+        } else if (name == "resize") {
+            int width, height;
+            if (!parsePair(value, 'x', width, height) || width <= 0 || height <= 0) {
+                error = "invalid resize '" + value + "', expected WIDTHxHEIGHT";
+                return false;
+            }
+            pipeline.stages.push_back(makeResizeStage(width, height));
+        } else if (name == "rotate") {
+            // rotate=DEGREES or rotate=DEGREES,crop|expand, clockwise
+            std::vector<std::string> parts = splitString(value, ',');
+            double angle = 0;
+            std::istringstream stream(parts.empty() ? "" : parts[0]);
+            std::string fitName = parts.size() == 2 ? trimWhitespace(parts[1]) : "crop";
+            if (!(stream >> angle) || !std::isfinite(angle) || parts.size() > 2 || (fitName != "crop" && fitName != "expand")) {
+                error = "invalid rotate '" + value + "', expected DEGREES[,crop|expand]";
+                return false;
+            }
+            pipeline.stages.push_back(makeRotateStage(angle, fitName == "expand" ? RotateFit::Expand : RotateFit::Crop));
+        } else if (name == "text") {
+            // X,Y,TEXT where the text may itself contain commas
+            size_t firstComma = value.find(',');
+            size_t secondComma = firstComma == std::string::npos ? std::string::npos : value.find(',', firstComma + 1);
+            int x, y;
+            if (secondComma == std::string::npos || !parsePair(value.substr(0, secondComma), ',', x, y)) {
+                error = "invalid text '" + value + "', expected X,Y,TEXT";
+                return false;
+            }
+            pipeline.stages.push_back(makeTextOverlayStage(value.substr(secondComma + 1), x, y));
+        } else if (name == "timedtext") {
+            // START:END,X,Y,TEXT shows the text only between START and END seconds
+            std::vector<std::string> parts = splitString(value, ',');
+            double start, end;
+            int x, y;
+            size_t textStart = parts.size() >= 4 ? parts[0].size() + parts[1].size() + parts[2].size() + 3 : std::string::npos;
+            if (textStart == std::string::npos || !parsePair(parts[0], ':', start, end) || start < 0 || start >= end ||
+                !parsePair(parts[1] + "," + parts[2], ',', x, y)) {
+                error = "invalid timedtext '" + value + "', expected START:END,X,Y,TEXT";
+                return false;
+            }
+            auto overlays = std::make_shared<OverlayCompositor>();
+            overlays->addText(value.substr(textStart), x, y, start, end);
+            pipeline.stages.push_back(makeOverlayStage(overlays));
+        } else if (name == "watermark") {
+            // X,Y,OPACITY,PATH where the path may contain commas
+            std::vector<std::string> parts = splitString(value, ',');
+            int x, y;
+            double opacity = -1;
+            std::istringstream opacityStream(parts.size() >= 4 ? parts[2] : "");
+            size_t pathStart = parts.size() >= 4 ? parts[0].size() + parts[1].size() + parts[2].size() + 3 : std::string::npos;
+            if (pathStart == std::string::npos || !parsePair(parts[0] + "," + parts[1], ',', x, y) || !(opacityStream >> opacity) ||
+                opacity < 0 || opacity > 1) {
+                error = "invalid watermark '" + value + "', expected X,Y,OPACITY,PATH with OPACITY between 0 and 1";
+                return false;
+            }
+            auto overlays = std::make_shared<OverlayCompositor>();
+            if (!overlays->addImage(value.substr(pathStart), x, y, opacity)) {
+                error = "could not read watermark image '" + value.substr(pathStart) + "'";
+                return false;
+            }
+            pipeline.stages.push_back(makeOverlayStage(overlays));
+        } else if (name == "grayscale" || name == "gray") {
+            pipeline.stages.push_back(makeGrayscaleStage());
+        } else if (name == "blur") {
+            // blur, blur=RADIUS or blur=RADIUS,METHOD
+            int radius = 7;
+            BlurMethod method = BlurMethod::Auto;
+            if (!value.empty()) {
+                std::vector<std::string> parts = splitString(value, ',');
+                std::istringstream stream(parts[0]);
+                if (!(stream >> radius) || radius < 1 || parts.size() > 2) {
+                    error = "invalid blur '" + value + "', expected RADIUS[,auto|gaussian|box|downscaled]";
+                    return false;
+                }
+                std::string methodName = parts.size() == 2 ? trimWhitespace(parts[1]) : "auto";
+                if (methodName == "gaussian") {
+                    method = BlurMethod::Gaussian;
+                } else if (methodName == "box") {
+                    method = BlurMethod::Box;
+                } else if (methodName == "downscaled") {
+                    method = BlurMethod::Downscaled;
+                } else if (methodName != "auto") {
+                    error = "unknown blur method '" + methodName + "'";
+                    return false;
+                }
+            }
+            pipeline.stages.push_back(makeBlurStage(radius, method));
+        } else {
+            error = "unknown operation '" + name + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseThumbnailSpec(const std::string& spec, ThumbnailOptions& options, std::string& error) {
+    std::vector<std::string> parts = splitString(spec, ',');
+    std::istringstream countStream(parts.empty() ? "" : parts[0]);
+    if (!(countStream >> options.count) || options.count < 1) {
+        error = "invalid thumbnails '" + spec + "', expected COUNT[,WIDTH|WIDTHxHEIGHT][,even|scene][,sheet|frames]";
+        return false;
+    }
+    for (size_t i = 1; i < parts.size(); i++) {
+        std::string part = trimWhitespace(parts[i]);
+        int width, height;
+        std::istringstream widthStream(part);
+        if (part == "even") {
+            options.selection = ThumbnailSelection::Even;
+        } else if (part == "scene") {
+            options.selection = ThumbnailSelection::SceneChange;
+        } else if (part == "sheet") {
+            options.contactSheet = true;
+        } else if (part == "frames") {
+            options.contactSheet = false;
+        } else if (parsePair(part, 'x', width, height) && width > 0 && height > 0) {
+            options.width = width;
+            options.height = height;
+        } else if ((widthStream >> width) && widthStream.eof() && width > 0) {
+            options.width = width;
+            options.height = 0;
+        } else {
+            error = "invalid thumbnails option '" + part + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+int codecForOutputPath(const std::string& outputPath) {
+    size_t dot = outputPath.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : outputPath.substr(dot + 1);
+    if (extension == "mp4" || extension == "mov") {
+        return cv::VideoWriter::fourcc('H', '2', '6', '4');  // H.264 for MP4 and MOV
+    }
+    return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');  // MJPEG for AVI and anything else
+}
+
+bool makeJob(const std::string& inputPath, const std::string& outputPath, const std::string& operations, JobSpec& job, std::string& error) {
+    job.inputPath = inputPath;
+    job.outputPath = outputPath;
+    job.operations = operations;
+    job.pipeline = FramePipeline();
+    job.codec = codecForOutputPath(outputPath);
+    job.thumbnails = false;
+
+    std::string chain = trimWhitespace(operations);
+    while (!chain.empty() && chain.back() == ';') {
+        chain = trimWhitespace(chain.substr(0, chain.size() - 1));
+    }
+    if (chain.rfind("thumbnails", 0) == 0) {
+        if (chain.find(';') != std::string::npos) {
+            error = "thumbnails cannot be combined with other operations";
+            return false;
+        }
+        job.thumbnails = true;
+        job.thumbnailOptions = ThumbnailOptions();
+        size_t equals = chain.find('=');
+        return parseThumbnailSpec(equals == std::string::npos ? "9" : chain.substr(equals + 1), job.thumbnailOptions, error);
+    }
+    return parseOperationChain(operations, job.pipeline, error);
+}
+
+bool loadManifest(const std::string& manifestPath, std::vector<JobSpec>& jobs, std::string& error) {
+    std::ifstream manifest(manifestPath);
+    if (!manifest) {
+        error = "could not open manifest " + manifestPath;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(manifest, line)) {
+        lineNumber++;
+        line = trimWhitespace(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        size_t firstComma = line.find(',');
+        size_t secondComma = firstComma == std::string::npos ? std::string::npos : line.find(',', firstComma + 1);
+        if (secondComma == std::string::npos) {
+            error = manifestPath + ":" + std::to_string(lineNumber) + ": expected input,output,operations";
+            return false;
+        }
+
+        JobSpec job;
+        std::string jobError;
+        if (!makeJob(trimWhitespace(line.substr(0, firstComma)), trimWhitespace(line.substr(firstComma + 1, secondComma - firstComma - 1)),
+                     line.substr(secondComma + 1), job, jobError)) {
+            error = manifestPath + ":" + std::to_string(lineNumber) + ": " + jobError;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+static bool runJobUncached(const JobSpec& job, const BatchOptions& options) {
+    if (job.thumbnails) {
+        return extractThumbnails(job.inputPath, job.outputPath, job.thumbnailOptions);
+    }
+    if (options.checkpointSeconds > 0 && job.inputPath != "-" && job.outputPath != "-") {
+        ResumeOptions resume;
+        resume.checkpointSeconds = options.checkpointSeconds;
+        resume.parallelSegments = options.segments;
+        resume.signature = job.operations + "#unchanged=" + std::to_string(options.pipeline.unchangedThreshold);
+        resume.pipeline = options.pipeline;
+        return runPipelineResumable(job.inputPath, job.outputPath, job.pipeline, job.codec, resume);
+    }
+    if (options.segments > 1) {
+        return runPipelineSegmented(job.inputPath, job.outputPath, job.pipeline, job.codec, options.segments, options.pipeline);
+    }
+    return runPipeline(job.inputPath, job.outputPath, job.pipeline, job.codec, options.pipeline);
+}
+
+// ".mp4" for "dir/video.mp4", empty when the file name has no extension
+static std::string fileExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    return dot == std::string::npos || (slash != std::string::npos && dot < slash) ? "" : path.substr(dot);
+}
+
+static std::string operationName(const std::string& operation) {
+    return operation.substr(0, operation.find('='));
+}
+
+// The job's operations in the order they take effect: trim cuts the source before any stage runs
+static std::vector<std::string> orderedOperations(const JobSpec& job) {
+    std::vector<std::string> trims;
+    std::vector<std::string> stages;
+    for (const std::string& rawOperation : splitString(job.operations, ';')) {
+        std::string operation = trimWhitespace(rawOperation);
+        if (!operation.empty()) {
+            (operationName(operation) == "trim" ? trims : stages).push_back(operation);
+        }
+    }
+    trims.insert(trims.end(), stages.begin(), stages.end());
+    return trims;
+}
+
+// Cache key of the first count operations. Watermarks add the content hash of their image, so replacing the
+// image at the same path does not return stale results, and skipping unchanged frames adds its threshold.
+static std::string operationsKey(ResultCache& cache, const std::string& inputDigest, const std::vector<std::string>& operations,
+                                 size_t count, const JobSpec& job, const BatchOptions& options) {
+    std::string chain;
+    for (size_t i = 0; i < count; i++) {
+        chain += operations[i] + ";";
+        if (operationName(operations[i]) == "watermark") {
+            std::vector<std::string> parts = splitString(operations[i], ',');
+            size_t pathStart = parts.size() >= 4 ? parts[0].size() + parts[1].size() + parts[2].size() + 3 : operations[i].size();
+            chain += "#" + cache.fileDigest(operations[i].substr(pathStart)) + ";";
+        }
+    }
+    if (options.pipeline.unchangedThreshold >= 0) {
+        chain += "#unchanged=" + std::to_string(options.pipeline.unchangedThreshold);
+    }
+    return cache.key(inputDigest, chain, job.codec, fileExtension(job.outputPath));
+}
+
+// Continues from the cached output of the longest leading part of the chain that an earlier job produced,
+// running only the remaining operations. Returns false without touching the output when there is none.
+// Such a result went through one more encode than a fresh run, so it is cached under a key derived from the
+// prefix entry and the remaining operations, never under the key of the full chain.
+static bool runFromCachedPrefix(const JobSpec& job, const BatchOptions& options, const std::string& inputDigest,
+                                const std::vector<std::string>& operations, bool& ok) {
+    ResultCache& cache = *options.cache;
+    std::string extension = fileExtension(job.outputPath);
+    size_t trims = 0;
+    bool timed = false;
+    for (const std::string& operation : operations) {
+        trims += operationName(operation) == "trim" ? 1 : 0;
+        timed = timed || operationName(operation) == "timedtext";
+    }
+    // A trimmed intermediate starts at time zero, which would shift the window of timed overlays
+    if (trims > 0 && timed) {
+        return false;
+    }
+
+    for (size_t count = operations.size(); count-- > std::max<size_t>(1, trims);) {
+        std::string prefixKey = operationsKey(cache, inputDigest, operations, count, job, options);
+        if (!cache.contains(prefixKey, extension)) {
+            continue;
+        }
+
+        std::vector<std::string> remaining(operations.begin() + count, operations.end());
+        std::string derivedKey = operationsKey(cache, prefixKey, remaining, remaining.size(), job, options);
+        if (cache.fetch(derivedKey, extension, job.outputPath)) {
+            cache.countPrefixHit();
+            ok = true;
+            return true;
+        }
+
+        JobSpec rest = job;
+        rest.inputPath = job.outputPath.substr(0, job.outputPath.size() - extension.size()) + ".cached" + extension;
+        rest.operations.clear();
+        for (const std::string& operation : remaining) {
+            rest.operations += operation + ";";
+        }
+        rest.pipeline = FramePipeline();
+        std::string error;
+        if (!parseOperationChain(rest.operations, rest.pipeline, error) || !cache.fetch(prefixKey, extension, rest.inputPath)) {
+            continue;
+        }
+
+        std::cout << "Continuing " << job.inputPath << " from a cached result of its first " << count << " operation(s)" << std::endl;
+        cache.countPrefixHit();
+        ok = runJobUncached(rest, options);
+        std::remove(rest.inputPath.c_str());
+        if (ok) {
+            cache.store(derivedKey, extension, job.outputPath);
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool runJob(const JobSpec& job, const BatchOptions& options) {
+    // Streams have no file contents to hash
+    if (!options.cache || job.inputPath == "-" || job.outputPath == "-") {
+        return runJobUncached(job, options);
+    }
+    ResultCache& cache = *options.cache;
+    std::string inputDigest = cache.fileDigest(job.inputPath);
+    if (inputDigest.empty()) {
+        return runJobUncached(job, options);
+    }
+
+    std::string extension = fileExtension(job.outputPath);
+    std::vector<std::string> operations = job.thumbnails ? std::vector<std::string>{trimWhitespace(job.operations)} : orderedOperations(job);
+    std::string key = operationsKey(cache, inputDigest, operations, operations.size(), job, options);
+    if (cache.fetch(key, extension, job.outputPath)) {
+        cache.countHit();
+        return true;
+    }
+
+    bool ok = false;
+    if (!job.thumbnails && runFromCachedPrefix(job, options, inputDigest, operations, ok)) {
+        return ok;
+    }
+    cache.countMiss();
+    ok = runJobUncached(job, options);
+    if (ok) {
+        cache.store(key, extension, job.outputPath);
+    }
+    return ok;
+}
+
+int runBatch(const std::vector<JobSpec>& jobs, const BatchOptions& options) {
+    int threadCount = std::max(1, std::min(options.concurrentJobs, static_cast<int>(jobs.size())));
+    std::atomic<size_t> nextJob(0);
+    std::atomic<int> failed(0);
+    std::mutex outputMutex;
+
+    auto batchStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back([&]() {
+            for (size_t index = nextJob++; index < jobs.size(); index = nextJob++) {
+                const JobSpec& job = jobs[index];
+                auto jobStart = std::chrono::steady_clock::now();
+                bool ok = runJob(job, options);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - jobStart;
+                if (!ok) {
+                    failed++;
+                }
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << (ok ? "[ok]     " : "[failed] ") << job.inputPath << " -> " << job.outputPath
+                          << " (" << elapsed.count() << " s)" << std::endl;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - batchStart;
+    std::cout << "Batch finished: " << static_cast<int>(jobs.size()) - failed << " succeeded, " << failed << " failed, "
+              << elapsed.count() << " s total" << std::endl;
+    if (options.cache) {
+        CacheStats cacheStats = options.cache->stats();
+        std::cout << "Cache: " << cacheStats.hits << " hits, " << cacheStats.prefixHits << " partial hits, " << cacheStats.misses
+                  << " misses, " << cacheStats.stores << " stored, " << cacheStats.evictions << " evicted" << std::endl;
+    }
+    return failed;
+}
@@ -0,0 +1,125 @@
+#include "frame_io.h"
+#include "video_processing.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+
+CaptureSource::CaptureSource(const std::string& path) : cap(path) {}
+
+bool CaptureSource::isOpened() const {
+    return cap.isOpened();
+}
+
+bool CaptureSource::read(cv::Mat& frame) {
+    return cap.read(frame);
+}
+
+bool CaptureSource::seek(int targetFrame) {
+    return seekToFrame(cap, targetFrame);
+}
+
+double CaptureSource::fps() const {
+    return cap.get(cv::CAP_PROP_FPS);
+}
+
+cv::Size CaptureSource::frameSize() const {
+    return cv::Size(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+int CaptureSource::frameCount() const {
+    int count = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    return count > 0 ? count : 0;
+}
+
+RawPipeSource::RawPipeSource(std::FILE* file, const cv::Size& size, double fps) : file(file), size(size), rate(fps) {}
+
+bool RawPipeSource::read(cv::Mat& frame) {
+    // create keeps the existing buffer when the size already matches, and its data is continuous
+    frame.create(size, CV_8UC3);
+    size_t bytes = frame.total() * frame.elemSize();
+    if (std::fread(frame.data, 1, bytes, file) != bytes) {
+        return false;
+    }
+    position++;
+    return true;
+}
+
+bool RawPipeSource::seek(int targetFrame) {
+    if (targetFrame < position) {
+        return false;
+    }
+    while (position < targetFrame) {
+        if (!read(skipped)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double RawPipeSource::fps() const {
+    return rate;
+}
+
+cv::Size RawPipeSource::frameSize() const {
+    return size;
+}
+
+int RawPipeSource::frameCount() const {
+    return 0;
+}
+
+WriterSink::WriterSink(const std::string& path, int codec, double fps, const cv::Size& size) : writer(path, codec, fps, size) {}
+
+bool WriterSink::isOpened() const {
+    return writer.isOpened();
+}
+
+void WriterSink::write(const cv::Mat& frame) {
+    writer.write(frame);
+}
+
+RawPipeSink::RawPipeSink(std::FILE* file) : file(file) {}
+
+void RawPipeSink::write(const cv::Mat& frame) {
+    const cv::Mat* output = &frame;
+    if (frame.type() != CV_8UC3) {
+        cv::cvtColor(frame, converted, cv::COLOR_GRAY2BGR);
+        output = &converted;
+    }
+    size_t rowBytes = output->cols * output->elemSize();
+    if (output->isContinuous()) {
+        std::fwrite(output->data, 1, rowBytes * output->rows, file);
+    } else {
+        for (int y = 0; y < output->rows; y++) {
+            std::fwrite(output->ptr(y), 1, rowBytes, file);
+        }
+    }
+    std::fflush(file);
+}
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string& path, const RawVideoFormat& raw) {
+    if (path == "-" && raw.size.area() > 0) {
+        return std::unique_ptr<FrameSource>(new RawPipeSource(stdin, raw.size, raw.fps));
+    }
+
+    // The FFmpeg backend reads a container stream from stdin through its pipe protocol
+    std::unique_ptr<CaptureSource> source(new CaptureSource(path == "-" ? "pipe:0" : path));
+    if (!source->isOpened()) {
+        std::cerr << "Error: Could not open video file for processing." << std::endl;
+        return nullptr;
+    }
+    return source;
+}
+
+std::unique_ptr<FrameSink> openFrameSink(const std::string& path, int codec, double fps, const cv::Size& size) {
+    if (path == "-") {
+        std::cerr << "Writing raw BGR24 frames of " << size.width << "x" << size.height << " at " << fps << " fps to stdout" << std::endl;
+        return std::unique_ptr<FrameSink>(new RawPipeSink(stdout));
+    }
+
+    std::unique_ptr<WriterSink> sink(new WriterSink(path, codec, fps, size));
+    if (!sink->isOpened()) {
+        std::cerr << "Error: Could not open output video file for processing." << std::endl;
+        return nullptr;
+    }
+    return sink;
+}
@@ -0,0 +1,494 @@
+#include "frame_pipeline.h"
+#include "video_processing.h"
+#include "bounded_queue.h"
+#include "frame_pool.h"
+#include "pipeline_stats.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef PipelineStats::Clock Clock;
+
+// Stage factories
+FrameStage makeTextOverlayStage(const std::string& text, int x, int y) {
+    auto overlays = std::make_shared<OverlayCompositor>();
+    overlays->addText(text, x, y);
+    return makeOverlayStage(overlays);
+}
+
+FrameStage makeOverlayStage(std::shared_ptr<const OverlayCompositor> overlays) {
+    FrameStage stage;
+    stage.name = "overlay";
+    stage.inPlace = true;
+    stage.timeVarying = overlays->isTimed();
+    stage.apply = [overlays](const cv::Mat&, cv::Mat& frame, double timestamp) {
+        overlays->apply(frame, timestamp);
+    };
+    return stage;
+}
+
+FrameStage makeResizeStage(int width, int height) {
+    FrameStage stage;
+    stage.name = "resize";
+    stage.apply = [width, height](const cv::Mat& input, cv::Mat& output, double) {
+        resizeFrame(input, output, width, height);
+    };
+    stage.applyDegraded = [width, height](const cv::Mat& input, cv::Mat& output, double) {
+        cv::resize(input, output, cv::Size(width, height), 0, 0, cv::INTER_NEAREST);
+    };
+    stage.outputSize = [width, height](const cv::Size&) {
+        return cv::Size(width, height);
+    };
+    return stage;
+}
+
+// Rotation maps for the frame size the stage last saw, built on the first frame and shared by every worker
+class SharedRotationMaps {
+public:
+    SharedRotationMaps(double angle, RotateFit fit) : angle(angle), fit(fit) {}
+
+    std::shared_ptr<const RotationMaps> get(const cv::Size& inputSize) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!maps || maps->inputSize != inputSize) {
+            maps = std::make_shared<RotationMaps>(buildRotationMaps(inputSize, angle, fit));
+        }
+        return maps;
+    }
+
+private:
+    double angle;
+    RotateFit fit;
+    std::mutex mutex;
+    std::shared_ptr<const RotationMaps> maps;
+};
+
+FrameStage makeRotateStage(double angle, RotateFit fit) {
+    FrameStage stage;
+    stage.name = "rotate";
+    angle = normalizeRotation(angle);
+    if (angle == 0) {
+        // Nothing to do, keep the frame untouched
+        stage.inPlace = true;
+        stage.apply = [](const cv::Mat&, cv::Mat&, double) {};
+        return stage;
+    }
+
+    if (std::fmod(angle, 90.0) == 0) {
+        int rightAngle = static_cast<int>(angle);
+        stage.apply = [rightAngle](const cv::Mat& input, cv::Mat& output, double) {
+            rotateFrame(input, output, rightAngle);
+        };
+        stage.outputSize = [rightAngle](const cv::Size& inputSize) {
+            if (rightAngle == 90 || rightAngle == 270) {
+                return cv::Size(inputSize.height, inputSize.width);
+            }
+            return inputSize;
+        };
+        return stage;
+    }
+
+    auto maps = std::make_shared<SharedRotationMaps>(angle, fit);
+    stage.apply = [maps](const cv::Mat& input, cv::Mat& output, double) {
+        rotateFrameWithMaps(input, output, *maps->get(input.size()));
+    };
+    stage.applyDegraded = [maps](const cv::Mat& input, cv::Mat& output, double) {
+        rotateFrameWithMaps(input, output, *maps->get(input.size()), true);
+    };
+    stage.outputSize = [maps](const cv::Size& inputSize) {
+        return maps->get(inputSize)->outputSize;
+    };
+    return stage;
+}
+
+FrameStage makeGrayscaleStage() {
+    FrameStage stage;
+    stage.name = "grayscale";
+    stage.apply = [](const cv::Mat& input, cv::Mat& output, double) {
+        grayscaleFrame(input, output);
+    };
+    return stage;
+}
+
+FrameStage makeBlurStage(int radius, BlurMethod method) {
+    FrameStage stage;
+    stage.name = "blur";
+    stage.apply = [radius, method](const cv::Mat& input, cv::Mat& output, double) {
+        blurFrame(input, output, radius, method);
+    };
+    stage.applyDegraded = [radius](const cv::Mat& input, cv::Mat& output, double) {
+        blurFrame(input, output, radius, radius > 3 ? BlurMethod::Downscaled : BlurMethod::Box);
+    };
+    return stage;
+}
+
+cv::Size pipelineOutputSize(const FramePipeline& pipeline, const cv::Size& inputSize) {
+    cv::Size size = inputSize;
+    for (const FrameStage& stage : pipeline.stages) {
+        if (stage.outputSize) {
+            size = stage.outputSize(size);
+        }
+    }
+    return size;
+}
+
+bool pipelineFrameRange(const FramePipeline& pipeline, double fps, int totalFrames, int& startFrame, int& endFrame) {
+    startFrame = 0;
+    endFrame = totalFrames > 0 ? totalFrames - 1 : INT_MAX;
+    if (pipeline.startTime >= 0 && pipeline.endTime >= 0) {
+        if (totalFrames <= 0) {
+            // A stream of unknown length can only be checked against itself
+            startFrame = static_cast<int>(pipeline.startTime * fps);
+            endFrame = static_cast<int>(pipeline.endTime * fps);
+            return fps > 0 && startFrame < endFrame;
+        }
+        return trimFrameRange(fps, totalFrames, pipeline.startTime, pipeline.endTime, startFrame, endFrame);
+    }
+    return true;
+}
+
+// Stats phases of a pipeline: decode, one per stage in order, then encode
+static size_t decodePhase() {
+    return 0;
+}
+
+static size_t stagePhase(size_t stage) {
+    return stage + 1;
+}
+
+static size_t encodePhase(const FramePipeline& pipeline) {
+    return pipeline.stages.size() + 1;
+}
+
+std::vector<std::string> pipelinePhaseNames(const FramePipeline& pipeline) {
+    std::vector<std::string> names{"decode"};
+    for (const FrameStage& stage : pipeline.stages) {
+        names.push_back(stage.name);
+    }
+    names.push_back("encode");
+    return names;
+}
+
+cv::Mat& applyPipelineStages(const FramePipeline& pipeline, std::vector<cv::Mat>& buffers, FramePool& pool, double timestamp,
+                             PipelineStats& stats, bool degraded) {
+    cv::Mat* current = &buffers[0];
+    for (size_t i = 0; i < pipeline.stages.size(); i++) {
+        const FrameStage& stage = pipeline.stages[i];
+        const auto& apply = degraded && stage.applyDegraded ? stage.applyDegraded : stage.apply;
+        Clock::time_point start = Clock::now();
+        if (stage.inPlace) {
+            apply(*current, *current, timestamp);
+            stats.recordPhase(stagePhase(i), start, Clock::now());
+            continue;
+        }
+
+        cv::Mat& output = buffers[i + 1];
+        cv::Size size = stage.outputSize ? stage.outputSize(cv::Size(current->cols, current->rows)) : cv::Size(current->cols, current->rows);
+        if (output.cols != size.width || output.rows != size.height || output.type() != current->type()) {
+            pool.release(output);
+            output = pool.acquire(size, current->type());
+        }
+        const uchar* data = output.data;
+        apply(*current, output, timestamp);
+        stats.recordPhase(stagePhase(i), start, Clock::now());
+        if (output.data != data) {
+            pool.countReallocation();
+        }
+        current = &output;
+    }
+    return *current;
+}
+
+// Decodes the next frame into a pooled buffer, counting it if the decoder had to replace the buffer
+static bool readFrame(FrameSource& source, cv::Mat& frame, FramePool& pool, PipelineStats& stats) {
+    const uchar* data = frame.data;
+    Clock::time_point start = Clock::now();
+    if (!source.read(frame)) {
+        return false;
+    }
+    stats.recordPhase(decodePhase(), start, Clock::now());
+    if (frame.data != data) {
+        pool.countReallocation();
+    }
+    return true;
+}
+
+// Everything the serial and threaded runners share for one pass over a frame range
+struct PipelineRun {
+    FrameSource& source;
+    FrameSink& sink;
+    const FramePipeline& pipeline;
+    const PipelineOptions& options;
+    FramePool& pool;
+    PipelineStats& stats;
+    cv::Size sourceSize;
+    double fps;
+    bool skipUnchanged;
+    int unchangedFrames = 0;
+
+    // Presentation time of a source frame in seconds
+    double timestamp(int frameIndex) const {
+        return fps > 0 ? frameIndex / fps : 0.0;
+    }
+
+    void write(const cv::Mat& frame) {
+        Clock::time_point start = Clock::now();
+        sink.write(frame);
+        stats.recordPhase(encodePhase(pipeline), start, Clock::now());
+        stats.frameWritten(options.progressInterval);
+    }
+};
+
+static void runSerial(PipelineRun& run, int frameIndex, int endFrame) {
+    // One buffer for the decoded frame plus one per stage, reused for every frame
+    std::vector<cv::Mat> buffers(run.pipeline.stages.size() + 1);
+    buffers[0] = run.pool.acquire(run.sourceSize, CV_8UC3);
+
+    if (!run.skipUnchanged) {
+        while (frameIndex <= endFrame && readFrame(run.source, buffers[0], run.pool, run.stats)) {
+            run.write(applyPipelineStages(run.pipeline, buffers, run.pool, run.timestamp(frameIndex), run.stats));
+            frameIndex++;
+        }
+    } else {
+        // Frames are decoded beside the stage buffers so the last output survives until a changed frame arrives
+        FrameChangeDetector detector(run.options.unchangedThreshold);
+        cv::Mat incoming = run.pool.acquire(run.sourceSize, CV_8UC3);
+        const cv::Mat* result = nullptr;
+        while (frameIndex <= endFrame && readFrame(run.source, incoming, run.pool, run.stats)) {
+            if (detector.unchanged(incoming) && result) {
+                run.unchangedFrames++;
+            } else {
+                cv::swap(buffers[0], incoming);
+                result = &applyPipelineStages(run.pipeline, buffers, run.pool, run.timestamp(frameIndex), run.stats);
+            }
+            run.write(*result);
+            frameIndex++;
+        }
+        run.pool.release(incoming);
+    }
+
+    for (cv::Mat& buffer : buffers) {
+        run.pool.release(buffer);
+    }
+}
+
+// A frame travelling through the threaded pipeline together with its stage buffers
+struct FrameTask {
+    int index = 0;
+    std::vector<cv::Mat> buffers;
+    cv::Mat* result = nullptr;
+    bool unchanged = false;  // Repeats the previous output, the stages do not run
+};
+
+static void runParallel(PipelineRun& run, int frameIndex, int endFrame) {
+    const FramePipeline& pipeline = run.pipeline;
+    FramePool& pool = run.pool;
+    int workerCount = run.options.workerThreads;
+    size_t capacity = run.options.queueCapacity > 0 ? run.options.queueCapacity : 1;
+
+    // Every frame in flight owns a task, so the number of tasks caps memory use
+    size_t taskCount = 2 * capacity + workerCount;
+    BoundedQueue<std::unique_ptr<FrameTask>> freeTasks(taskCount);
+    BoundedQueue<std::unique_ptr<FrameTask>> decoded(capacity);
+    BoundedQueue<std::unique_ptr<FrameTask>> processed(capacity);
+    for (size_t i = 0; i < taskCount; i++) {
+        std::unique_ptr<FrameTask> task(new FrameTask());
+        task->buffers.resize(pipeline.stages.size() + 1);
+        task->buffers[0] = pool.acquire(run.sourceSize, CV_8UC3);
+        freeTasks.push(std::move(task));
+    }
+
+    // Change detection runs on the decoder thread, which sees every frame in order
+    std::thread decoder([&]() {
+        FrameChangeDetector detector(run.options.unchangedThreshold);
+        std::unique_ptr<FrameTask> task;
+        int index = frameIndex;
+        while (index <= endFrame && freeTasks.pop(task)) {
+            if (!readFrame(run.source, task->buffers[0], pool, run.stats)) {
+                break;
+            }
+            task->unchanged = run.skipUnchanged && detector.unchanged(task->buffers[0]);
+            run.unchangedFrames += task->unchanged ? 1 : 0;
+            task->index = index++;
+            run.stats.sampleQueues(decoded.size(), decoded.capacity(), processed.size(), processed.capacity());
+            decoded.push(std::move(task));
+        }
+        decoded.close();
+    });
+
+    std::atomic<int> activeWorkers(workerCount);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back([&]() {
+            std::unique_ptr<FrameTask> task;
+            while (decoded.pop(task)) {
+                if (!task->unchanged) {
+                    task->result = &applyPipelineStages(pipeline, task->buffers, pool, run.timestamp(task->index), run.stats);
+                }
+                processed.push(std::move(task));
+            }
+            if (--activeWorkers == 0) {
+                processed.close();
+            }
+        });
+    }
+
+    // Encoder: write frames back in decode order, holding early ones until their turn. The last processed task
+    // is kept back from the decoder while unchanged frames still repeat its output.
+    std::map<int, std::unique_ptr<FrameTask>> pending;
+    int nextIndex = frameIndex;
+    std::unique_ptr<FrameTask> task;
+    std::unique_ptr<FrameTask> lastProcessed;
+    while (processed.pop(task)) {
+        pending[task->index] = std::move(task);
+        auto it = pending.find(nextIndex);
+        while (it != pending.end()) {
+            std::unique_ptr<FrameTask> ready = std::move(it->second);
+            pending.erase(it);
+            if (ready->unchanged) {
+                run.write(*lastProcessed->result);
+                freeTasks.push(std::move(ready));
+            } else {
+                run.write(*ready->result);
+                if (lastProcessed) {
+                    freeTasks.push(std::move(lastProcessed));
+                }
+                lastProcessed = std::move(ready);
+            }
+            it = pending.find(++nextIndex);
+        }
+    }
+    if (lastProcessed) {
+        freeTasks.push(std::move(lastProcessed));
+    }
+
+    freeTasks.close();
+    decoder.join();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Hand the task buffers back so a shared pool can reuse them for the next job
+    while (freeTasks.pop(task)) {
+        for (cv::Mat& buffer : task->buffers) {
+            pool.release(buffer);
+        }
+    }
+}
+
+// Opens the output, seeks to startFrame and processes frames up to endFrame (inclusive)
+static bool processFrameRange(FrameSource& source, const std::string& inputPath, const std::string& outputPath,
+                              const FramePipeline& pipeline, int codec, int startFrame, int endFrame, const PipelineOptions& options) {
+    double fps = source.fps();
+    cv::Size sourceSize = source.frameSize();
+
+    std::unique_ptr<FrameSink> sink = openFrameSink(outputPath, codec, fps, pipelineOutputSize(pipeline, sourceSize));
+    if (!sink) {
+        return false;
+    }
+
+    FramePool localPool;
+    FramePool& pool = options.framePool ? *options.framePool : localPool;
+
+    // Seek straight to the first frame so skipped frames are not even decoded
+    if (!source.seek(startFrame)) {
+        std::cerr << "Error: Could not seek to the start of the trim window." << std::endl;
+        return false;
+    }
+
+    // The expected length comes from the source's frame count, endFrame is INT_MAX when that is unknown
+    int expectedFrames = endFrame == INT_MAX ? 0 : endFrame - startFrame + 1;
+    PipelineStats stats(pipelinePhaseNames(pipeline), expectedFrames, outputPath, !options.tracePath.empty());
+
+    // Reusing an output is only valid when the stages give the same result for the same frame at any time
+    bool skipUnchanged = options.unchangedThreshold >= 0 &&
+                         std::none_of(pipeline.stages.begin(), pipeline.stages.end(), [](const FrameStage& stage) { return stage.timeVarying; });
+    if (options.unchangedThreshold >= 0 && !skipUnchanged && options.verbose) {
+        std::cout << "Timed overlays change output over time, processing every frame." << std::endl;
+    }
+
+    PipelineRun run{source, *sink, pipeline, options, pool, stats, sourceSize, fps, skipUnchanged};
+    if (options.workerThreads > 0) {
+        if (options.verbose) {
+            std::cout << "Processing video frames on " << options.workerThreads << " worker thread(s)..." << std::endl;
+        }
+        runParallel(run, startFrame, endFrame);
+    } else {
+        if (options.verbose) {
+            std::cout << "Processing video frames..." << std::endl;
+        }
+        runSerial(run, startFrame, endFrame);
+    }
+
+    FramePoolStats poolStats = pool.stats();
+    if (options.verbose) {
+        double elapsed = stats.elapsedSeconds();
+        std::cout << "Processed " << stats.framesWritten() << " frame(s) in " << elapsed << " s ("
+                  << (elapsed > 0 ? stats.framesWritten() / elapsed : 0.0) << " fps)" << std::endl;
+        for (const PhaseSummary& phase : stats.phaseSummaries()) {
+            std::cout << "  " << phase.name << ": " << phase.totalMs << " ms total, p50 " << phase.p50Ms << " ms, p99 " << phase.p99Ms
+                      << " ms" << std::endl;
+        }
+        if (skipUnchanged) {
+            std::cout << "Unchanged frames: " << run.unchangedFrames << " of " << stats.framesWritten() << " reused the previous output"
+                      << std::endl;
+        }
+        std::cout << "Frame buffers: " << poolStats.allocations << " allocated, " << poolStats.reuses << " reused, "
+                  << poolStats.reallocations << " reallocated by stages" << std::endl;
+        std::cout << "Frame pipeline complete. Output saved to " << outputPath << std::endl;
+    }
+
+    if (!options.statsPath.empty()) {
+        std::string fields = "\"input\":\"" + jsonEscape(inputPath) + "\",\"output\":\"" + jsonEscape(outputPath) +
+                             "\",\"worker_threads\":" + std::to_string(options.workerThreads) +
+                             ",\"unchanged_frames\":" + std::to_string(run.unchangedFrames) +
+                             ",\"pool\":{\"allocations\":" + std::to_string(poolStats.allocations) +
+                             ",\"reuses\":" + std::to_string(poolStats.reuses) +
+                             ",\"reallocations\":" + std::to_string(poolStats.reallocations) + "},";
+        appendStatsRecord(stats, options.statsPath, fields);
+    }
+    if (!options.tracePath.empty()) {
+        stats.writeTrace(options.tracePath);
+    }
+    return true;
+}
+
+// Fused pipeline runner
+bool runPipeline(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                 const PipelineOptions& options) {
+    if (options.verbose) {
+        std::cout << "Preparing frame pipeline with " << pipeline.stages.size() << " stage(s)..." << std::endl;
+    }
+
+    std::unique_ptr<FrameSource> source = openFrameSource(inputPath, options.rawInput);
+    if (!source) {
+        return false;
+    }
+
+    double fps = source->fps();
+    int totalFrames = source->frameCount();
+
+    // Trim is applied first so frames outside the window never reach a stage
+    int startFrame, endFrame;
+    if (!pipelineFrameRange(pipeline, fps, totalFrames, startFrame, endFrame)) {
+        std::cerr << "Error: Invalid start or end time for trimming." << std::endl;
+        return false;
+    }
+
+    return processFrameRange(*source, inputPath, outputPath, pipeline, codec, startFrame, endFrame, options);
+}
+
+bool runPipelineFrames(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                       int startFrame, int endFrame, const PipelineOptions& options) {
+    std::unique_ptr<FrameSource> source = openFrameSource(inputPath, options.rawInput);
+    if (!source) {
+        return false;
+    }
+    return processFrameRange(*source, inputPath, outputPath, pipeline, codec, startFrame, endFrame, options);
+}
@@ -0,0 +1,35 @@
+#include "frame_pool.h"
+
+cv::Mat FramePool::acquire(const cv::Size& size, int type) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = freeFrames.find(std::make_tuple(size.width, size.height, type));
+        if (it != freeFrames.end() && !it->second.empty()) {
+            cv::Mat frame = it->second.back();
+            it->second.pop_back();
+            counters.reuses++;
+            return frame;
+        }
+        counters.allocations++;
+    }
+    return cv::Mat(size, type);
+}
+
+void FramePool::release(cv::Mat& frame) {
+    if (frame.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    freeFrames[std::make_tuple(frame.cols, frame.rows, frame.type())].push_back(frame);
+    frame.release();
+}
+
+void FramePool::countReallocation() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.reallocations++;
+}
+
+FramePoolStats FramePool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
@@ -0,0 +1,569 @@
+#include "libav_io.h"
+
+#ifdef HAVE_LIBAV
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/display.h>
+#include <libswscale/swscale.h>
+}
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// Input container with its best video stream, closed on scope exit
+struct InputFile {
+    AVFormatContext* context = nullptr;
+    int videoStream = -1;
+
+    ~InputFile() {
+        if (context) {
+            avformat_close_input(&context);
+        }
+    }
+};
+
+// Output container, closed on scope exit
+struct OutputFile {
+    AVFormatContext* context = nullptr;
+
+    ~OutputFile() {
+        if (!context) {
+            return;
+        }
+        if (!(context->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&context->pb);
+        }
+        avformat_free_context(context);
+    }
+};
+
+static bool openInput(const std::string& path, InputFile& input) {
+    if (avformat_open_input(&input.context, path.c_str(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    if (avformat_find_stream_info(input.context, nullptr) < 0) {
+        return false;
+    }
+    input.videoStream = av_find_best_stream(input.context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    return input.videoStream >= 0;
+}
+
+// Maps the fourcc codes offered by main.cpp to libav codec ids
+static AVCodecID codecIdForFourcc(int codec) {
+    char tag[5] = {static_cast<char>(codec & 0xFF), static_cast<char>((codec >> 8) & 0xFF),
+                   static_cast<char>((codec >> 16) & 0xFF), static_cast<char>((codec >> 24) & 0xFF), 0};
+    std::string fourcc(tag);
+    if (fourcc == "MJPG") {
+        return AV_CODEC_ID_MJPEG;
+    }
+    if (fourcc == "H264" || fourcc == "X264" || fourcc == "avc1" || fourcc == "AVC1") {
+        return AV_CODEC_ID_H264;
+    }
+    if (fourcc == "HEVC" || fourcc == "H265" || fourcc == "hvc1" || fourcc == "hev1") {
+        return AV_CODEC_ID_HEVC;
+    }
+    if (fourcc == "MP4V" || fourcc == "mp4v" || fourcc == "XVID" || fourcc == "FMP4" || fourcc == "DIVX") {
+        return AV_CODEC_ID_MPEG4;
+    }
+    return AV_CODEC_ID_NONE;
+}
+
+bool canStreamCopy(const std::string& inputPath, const std::string& outputPath, int codec) {
+    InputFile input;
+    if (!openInput(inputPath, input)) {
+        return false;
+    }
+
+    AVCodecID codecId = input.context->streams[input.videoStream]->codecpar->codec_id;
+    if (codecId == AV_CODEC_ID_NONE || codecId != codecIdForFourcc(codec)) {
+        return false;
+    }
+
+    const AVOutputFormat* format = av_guess_format(nullptr, outputPath.c_str(), nullptr);
+    return format && avformat_query_codec(format, codecId, FF_COMPLIANCE_NORMAL) == 1;
+}
+
+// With B-frames, frames before a cut may reference one after it in display order. The cut at endTs is only
+// clean when the first packet past it, already read into packet, is a keyframe and none of the leading frames
+// decoded after that keyframe belongs before the cut.
+static bool cleanEndCut(InputFile& input, AVPacket* packet, int64_t endTs) {
+    if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+        return false;
+    }
+    int64_t keyPts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    bool clean = true;
+    AVPacket* next = av_packet_alloc();
+    while (clean && av_read_frame(input.context, next) >= 0) {
+        if (next->stream_index != input.videoStream) {
+            av_packet_unref(next);
+            continue;
+        }
+        int64_t pts = next->pts != AV_NOPTS_VALUE ? next->pts : next->dts;
+        av_packet_unref(next);
+        if (pts > keyPts) {
+            break;
+        }
+        clean = pts > endTs;
+    }
+    av_packet_free(&next);
+    return clean;
+}
+
+bool streamCopyVideo(const std::string& inputPath, const std::string& outputPath, double startTime, double endTime) {
+    InputFile input;
+    if (!openInput(inputPath, input)) {
+        return false;
+    }
+
+    AVStream* inStream = input.context->streams[input.videoStream];
+    AVRational timeBase = inStream->time_base;
+    int64_t streamStart = inStream->start_time != AV_NOPTS_VALUE ? inStream->start_time : 0;
+    int64_t startTs = streamStart;
+    if (startTime > 0) {
+        startTs += av_rescale_q(std::llround(startTime * AV_TIME_BASE), AV_TIME_BASE_Q, timeBase);
+    }
+
+    // Half a frame of slack when matching packet timestamps against the requested boundaries
+    int64_t tolerance = 0;
+    AVRational frameRate = inStream->avg_frame_rate.num ? inStream->avg_frame_rate : inStream->r_frame_rate;
+    if (frameRate.num > 0 && frameRate.den > 0) {
+        tolerance = av_rescale_q(1, av_inv_q(frameRate), timeBase) / 2;
+    }
+
+    int64_t endTs = INT64_MAX;
+    if (endTime >= 0) {
+        endTs = streamStart + av_rescale_q(std::llround(endTime * AV_TIME_BASE), AV_TIME_BASE_Q, timeBase) + tolerance;
+    }
+
+    if (startTime > 0 && av_seek_frame(input.context, input.videoStream, startTs, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+
+    OutputFile output;
+    if (avformat_alloc_output_context2(&output.context, nullptr, nullptr, outputPath.c_str()) < 0) {
+        return false;
+    }
+    AVStream* outStream = avformat_new_stream(output.context, nullptr);
+    if (!outStream || avcodec_parameters_copy(outStream->codecpar, inStream->codecpar) < 0) {
+        return false;
+    }
+    outStream->codecpar->codec_tag = 0;  // Let the muxer pick the tag used by its container
+    outStream->time_base = timeBase;
+
+    if (!(output.context->oformat->flags & AVFMT_NOFILE) && avio_open(&output.context->pb, outputPath.c_str(), AVIO_FLAG_WRITE) < 0) {
+        return false;
+    }
+    if (avformat_write_header(output.context, nullptr) < 0) {
+        return false;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    bool copying = false;
+    bool ok = true;
+    int64_t offset = 0;
+    while (av_read_frame(input.context, packet) >= 0) {
+        if (packet->stream_index != input.videoStream) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (!copying) {
+            // The copy has to begin on a keyframe at the requested start, otherwise the caller transcodes
+            if (!(packet->flags & AV_PKT_FLAG_KEY) || std::llabs(pts - startTs) > tolerance) {
+                av_packet_unref(packet);
+                ok = false;
+                break;
+            }
+            offset = packet->dts != AV_NOPTS_VALUE ? packet->dts : pts;
+            copying = true;
+        }
+
+        // Without B-frames packets arrive in presentation order and the first one past the end finishes the
+        // copy. With them, an incomplete tail is left to the caller to transcode.
+        if (pts > endTs) {
+            ok = inStream->codecpar->video_delay == 0 || cleanEndCut(input, packet, endTs);
+            av_packet_unref(packet);
+            break;
+        }
+
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= offset;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= offset;
+        }
+        packet->stream_index = outStream->index;
+        packet->pos = -1;
+        av_packet_rescale_ts(packet, timeBase, outStream->time_base);
+        if (av_interleaved_write_frame(output.context, packet) < 0) {
+            ok = false;
+            break;
+        }
+    }
+    av_packet_free(&packet);
+
+    av_write_trailer(output.context);
+    if (!ok || !copying) {
+        std::remove(outputPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Frame duration of the stream expressed in its own time base, at least one tick
+static int64_t frameDuration(const AVStream* stream) {
+    AVRational frameRate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        return 1;
+    }
+    int64_t duration = av_rescale_q(1, av_inv_q(frameRate), stream->time_base);
+    return duration > 0 ? duration : 1;
+}
+
+std::vector<int> buildKeyframeIndex(const std::string& inputPath) {
+    std::vector<int> keyframes;
+    InputFile input;
+    if (!openInput(inputPath, input)) {
+        return keyframes;
+    }
+
+    const AVStream* stream = input.context->streams[input.videoStream];
+    int64_t streamStart = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    int64_t duration = frameDuration(stream);
+
+    AVPacket* packet = av_packet_alloc();
+    while (av_read_frame(input.context, packet) >= 0) {
+        if (packet->stream_index == input.videoStream && (packet->flags & AV_PKT_FLAG_KEY)) {
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (pts != AV_NOPTS_VALUE) {
+                keyframes.push_back(static_cast<int>((pts - streamStart + duration / 2) / duration));
+            }
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    std::sort(keyframes.begin(), keyframes.end());
+    keyframes.erase(std::unique(keyframes.begin(), keyframes.end()), keyframes.end());
+    return keyframes;
+}
+
+std::vector<int> keyframesAtOrBefore(const std::string& inputPath, const std::vector<int>& frames) {
+    std::vector<int> keyframes;
+    InputFile input;
+    if (!openInput(inputPath, input)) {
+        return keyframes;
+    }
+
+    const AVStream* stream = input.context->streams[input.videoStream];
+    int64_t streamStart = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    int64_t duration = frameDuration(stream);
+
+    // The demuxer resolves each seek from the container's index, then a single packet tells where it landed
+    AVPacket* packet = av_packet_alloc();
+    for (int frame : frames) {
+        int keyframe = -1;
+        if (av_seek_frame(input.context, input.videoStream, streamStart + frame * duration, AVSEEK_FLAG_BACKWARD) >= 0) {
+            while (av_read_frame(input.context, packet) >= 0) {
+                bool video = packet->stream_index == input.videoStream;
+                int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                if (video && pts != AV_NOPTS_VALUE) {
+                    keyframe = static_cast<int>((pts - streamStart + duration / 2) / duration);
+                }
+                av_packet_unref(packet);
+                if (video) {
+                    break;
+                }
+            }
+        }
+        if (keyframe < 0) {
+            keyframes.clear();
+            break;
+        }
+        keyframes.push_back(keyframe);
+    }
+    av_packet_free(&packet);
+    return keyframes;
+}
+
+bool videoFullRange(const std::string& inputPath, bool& fullRange) {
+    InputFile input;
+    if (!openInput(inputPath, input)) {
+        return false;
+    }
+
+    // Streams that do not state their range follow their pixel format: the yuvj formats and JPEG are full
+    // range, gray is full range, everything else is limited range video
+    const AVCodecParameters* parameters = input.context->streams[input.videoStream]->codecpar;
+    if (parameters->color_range == AVCOL_RANGE_JPEG || parameters->color_range == AVCOL_RANGE_MPEG) {
+        fullRange = parameters->color_range == AVCOL_RANGE_JPEG;
+        return true;
+    }
+    AVPixelFormat format = static_cast<AVPixelFormat>(parameters->format);
+    fullRange = format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_YUVJ422P || format == AV_PIX_FMT_YUVJ444P ||
+                format == AV_PIX_FMT_YUVJ440P || format == AV_PIX_FMT_GRAY8 || parameters->codec_id == AV_CODEC_ID_MJPEG;
+    return true;
+}
+
+bool concatVideos(const std::vector<std::string>& inputPaths, const std::string& outputPath) {
+    if (inputPaths.empty()) {
+        return false;
+    }
+
+    OutputFile output;
+    if (avformat_alloc_output_context2(&output.context, nullptr, nullptr, outputPath.c_str()) < 0) {
+        return false;
+    }
+
+    AVStream* outStream = nullptr;
+    AVRational timeBase = {0, 1};
+    int64_t offset = 0;  // Start of the current input on the joined timeline, in timeBase units
+    AVPacket* packet = av_packet_alloc();
+    bool headerWritten = false;
+    bool ok = true;
+
+    for (const std::string& path : inputPaths) {
+        InputFile input;
+        if (!openInput(path, input)) {
+            ok = false;
+            break;
+        }
+        AVStream* inStream = input.context->streams[input.videoStream];
+
+        if (!outStream) {
+            // The first input defines the stream parameters of the joined file
+            outStream = avformat_new_stream(output.context, nullptr);
+            if (!outStream || avcodec_parameters_copy(outStream->codecpar, inStream->codecpar) < 0) {
+                ok = false;
+                break;
+            }
+            outStream->codecpar->codec_tag = 0;
+            outStream->time_base = inStream->time_base;
+            timeBase = inStream->time_base;
+            if (!(output.context->oformat->flags & AVFMT_NOFILE) && avio_open(&output.context->pb, outputPath.c_str(), AVIO_FLAG_WRITE) < 0) {
+                ok = false;
+                break;
+            }
+            if (avformat_write_header(output.context, nullptr) < 0) {
+                ok = false;
+                break;
+            }
+            headerWritten = true;
+        } else if (inStream->codecpar->codec_id != outStream->codecpar->codec_id ||
+                   inStream->codecpar->width != outStream->codecpar->width ||
+                   inStream->codecpar->height != outStream->codecpar->height) {
+            ok = false;
+            break;
+        }
+
+        int64_t first = AV_NOPTS_VALUE;
+        int64_t end = offset;
+        int64_t duration = av_rescale_q(frameDuration(inStream), inStream->time_base, timeBase);
+        while (av_read_frame(input.context, packet) >= 0) {
+            if (packet->stream_index != input.videoStream) {
+                av_packet_unref(packet);
+                continue;
+            }
+            av_packet_rescale_ts(packet, inStream->time_base, timeBase);
+            if (first == AV_NOPTS_VALUE) {
+                first = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            }
+            if (packet->pts != AV_NOPTS_VALUE) {
+                packet->pts += offset - first;
+                end = std::max(end, packet->pts + (packet->duration > 0 ? packet->duration : duration));
+            }
+            if (packet->dts != AV_NOPTS_VALUE) {
+                packet->dts += offset - first;
+            }
+            packet->stream_index = outStream->index;
+            packet->pos = -1;
+            av_packet_rescale_ts(packet, timeBase, outStream->time_base);
+            if (av_interleaved_write_frame(output.context, packet) < 0) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+        offset = end;
+    }
+    av_packet_free(&packet);
+
+    if (headerWritten) {
+        av_write_trailer(output.context);
+    }
+    if (!ok) {
+        std::remove(outputPath.c_str());
+    }
+    return ok;
+}
+
+// Rotation in degrees recorded in the stream's display matrix, 0 when there is none
+static double displayRotation(const AVStream* stream) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 30, 100)
+    const AVPacketSideData* sideData =
+        av_packet_side_data_get(stream->codecpar->coded_side_data, stream->codecpar->nb_coded_side_data, AV_PKT_DATA_DISPLAYMATRIX);
+    const uint8_t* matrix = sideData ? sideData->data : nullptr;
+#else
+    const uint8_t* matrix = av_stream_get_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX, nullptr);
+#endif
+    return matrix ? av_display_rotation_get(reinterpret_cast<const int32_t*>(matrix)) : 0.0;
+}
+
+struct ScaledDecoder::State {
+    InputFile input;
+    AVCodecContext* codec = nullptr;
+    AVFrame* frame = nullptr;
+    AVPacket* packet = nullptr;
+    SwsContext* scaler = nullptr;
+    cv::Size outputSize;
+    double fps = 0;
+
+    ~State() {
+        sws_freeContext(scaler);
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&codec);
+    }
+};
+
+bool ScaledDecoder::open(const std::string& inputPath, const cv::Size& outputSize) {
+    std::unique_ptr<State> opened(new State());
+    if (!openInput(inputPath, opened->input)) {
+        return false;
+    }
+
+    // cv::VideoCapture applies the display rotation, a decoder that ignores it would produce different frames
+    const AVStream* stream = opened->input.context->streams[opened->input.videoStream];
+    if (std::fabs(displayRotation(stream)) > 0.5) {
+        return false;
+    }
+
+    const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+        return false;
+    }
+    opened->codec = avcodec_alloc_context3(decoder);
+    if (!opened->codec || avcodec_parameters_to_context(opened->codec, stream->codecpar) < 0) {
+        return false;
+    }
+
+    // Decoders with a lowres mode (e.g. MJPEG) skip detail at 1/2, 1/4 or 1/8 size while it still covers the target
+    int lowres = 0;
+    while (lowres < decoder->max_lowres && (stream->codecpar->width >> (lowres + 1)) >= outputSize.width &&
+           (stream->codecpar->height >> (lowres + 1)) >= outputSize.height) {
+        lowres++;
+    }
+    opened->codec->lowres = lowres;
+    opened->codec->thread_count = 0;  // One decoding thread per core
+    if (avcodec_open2(opened->codec, decoder, nullptr) < 0) {
+        return false;
+    }
+
+    opened->frame = av_frame_alloc();
+    opened->packet = av_packet_alloc();
+    if (!opened->frame || !opened->packet) {
+        return false;
+    }
+    AVRational frameRate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+    opened->fps = frameRate.num > 0 && frameRate.den > 0 ? av_q2d(frameRate) : 0.0;
+    opened->outputSize = outputSize;
+    state = std::move(opened);
+    return true;
+}
+
+bool ScaledDecoder::read(cv::Mat& frame) {
+    if (!state) {
+        return false;
+    }
+    State& decoding = *state;
+
+    int result;
+    while ((result = avcodec_receive_frame(decoding.codec, decoding.frame)) == AVERROR(EAGAIN)) {
+        if (av_read_frame(decoding.input.context, decoding.packet) < 0) {
+            // End of input, drain the frames the decoder still holds
+            avcodec_send_packet(decoding.codec, nullptr);
+            continue;
+        }
+        if (decoding.packet->stream_index == decoding.input.videoStream) {
+            avcodec_send_packet(decoding.codec, decoding.packet);  // A damaged packet is skipped like cv::VideoCapture does
+        }
+        av_packet_unref(decoding.packet);
+    }
+    if (result < 0) {
+        return false;
+    }
+
+    // Area averaging when shrinking, bilinear otherwise, converting to BGR in the same pass
+    const AVFrame* source = decoding.frame;
+    bool shrinking = decoding.outputSize.width < source->width && decoding.outputSize.height < source->height;
+    decoding.scaler = sws_getCachedContext(decoding.scaler, source->width, source->height, static_cast<AVPixelFormat>(source->format),
+                                           decoding.outputSize.width, decoding.outputSize.height, AV_PIX_FMT_BGR24,
+                                           shrinking ? SWS_AREA : SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!decoding.scaler) {
+        av_frame_unref(decoding.frame);
+        return false;
+    }
+
+    frame.create(decoding.outputSize, CV_8UC3);
+    uint8_t* destination[] = {frame.data};
+    int destinationStride[] = {static_cast<int>(frame.step)};
+    sws_scale(decoding.scaler, source->data, source->linesize, 0, source->height, destination, destinationStride);
+    av_frame_unref(decoding.frame);
+    return true;
+}
+
+#else
+
+bool canStreamCopy(const std::string&, const std::string&, int) {
+    return false;
+}
+
+bool streamCopyVideo(const std::string&, const std::string&, double, double) {
+    return false;
+}
+
+std::vector<int> buildKeyframeIndex(const std::string&) {
+    return std::vector<int>();
+}
+
+std::vector<int> keyframesAtOrBefore(const std::string&, const std::vector<int>&) {
+    return std::vector<int>();
+}
+
+bool videoFullRange(const std::string&, bool&) {
+    return false;
+}
+
+bool concatVideos(const std::vector<std::string>&, const std::string&) {
+    return false;
+}
+
+struct ScaledDecoder::State {
+    double fps = 0;
+};
+
+bool ScaledDecoder::open(const std::string&, const cv::Size&) {
+    return false;
+}
+
+bool ScaledDecoder::read(cv::Mat&) {
+    return false;
+}
+
+#endif
+
+ScaledDecoder::ScaledDecoder() {}
+
+ScaledDecoder::~ScaledDecoder() {}
+
+double ScaledDecoder::fps() const {
+    return state ? state->fps : 0.0;
+}
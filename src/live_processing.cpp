@@ -0,0 +1,263 @@
+#include "live_processing.h"
+#include "frame_pool.h"
+#include "pipeline_stats.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef PipelineStats::Clock Clock;
+
+// Set by the SIGINT handler and read by the capture and processing threads, lock-free so the handler may touch it
+static std::atomic<bool> interrupted(false);
+static_assert(std::atomic<bool>::is_always_lock_free, "the interrupt flag is written from a signal handler");
+
+static void onInterrupt(int) {
+    interrupted = true;
+}
+
+// A captured frame and the moment it left the source
+struct LiveFrame {
+    cv::Mat image;
+    Clock::time_point captured;
+};
+
+// Frames handed from the capture thread to processing. Capture never waits: once limit frames are waiting
+// the oldest is discarded. Spent buffers come back through recycle so capture stops allocating.
+class LiveQueue {
+public:
+    explicit LiveQueue(size_t limit) : limit(std::max<size_t>(1, limit)) {}
+
+    // Returns the number of frames discarded to make room
+    size_t push(LiveFrame& frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t dropped = 0;
+        while (frames.size() >= limit) {
+            spare.push_back(frames.front().image);
+            frames.pop_front();
+            dropped++;
+        }
+        frames.push_back(frame);
+        ready.notify_one();
+        return dropped;
+    }
+
+    // Waits for the next frame, backlog is set to the frames still waiting behind it. False once closed and empty.
+    bool pop(LiveFrame& frame, size_t& backlog) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this]() { return !frames.empty() || closed; });
+        if (frames.empty()) {
+            return false;
+        }
+        frame = frames.front();
+        frames.pop_front();
+        backlog = frames.size();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        ready.notify_all();
+    }
+
+    // A buffer for the next capture, reusing a spent one when there is one
+    cv::Mat takeBuffer() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spare.empty()) {
+            return cv::Mat();
+        }
+        cv::Mat buffer = spare.back();
+        spare.pop_back();
+        return buffer;
+    }
+
+    void recycle(cv::Mat& buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        spare.push_back(buffer);
+        buffer.release();
+    }
+
+private:
+    size_t limit;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<LiveFrame> frames;
+    std::vector<cv::Mat> spare;
+    bool closed = false;
+};
+
+// Camera indices are plain numbers, anything else is a URL, device path or file
+static bool openLiveSource(const std::string& source, cv::VideoCapture& cap) {
+    bool isIndex = !source.empty() && std::all_of(source.begin(), source.end(), [](char c) { return c >= '0' && c <= '9'; });
+    return isIndex ? cap.open(std::atoi(source.c_str())) : cap.open(source);
+}
+
+static const char* policyName(DropPolicy policy) {
+    switch (policy) {
+        case DropPolicy::SkipProcessing:
+            return "skip";
+        case DropPolicy::LowerQuality:
+            return "lower-quality";
+        default:
+            return "drop-oldest";
+    }
+}
+
+bool runLive(const std::string& source, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+             const LiveOptions& options) {
+    cv::VideoCapture cap;
+    if (!openLiveSource(source, cap)) {
+        std::cerr << "Error: Could not open live source " << source << std::endl;
+        return false;
+    }
+    // Cameras often report no rate, the output still needs one
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    double outputFps = fps > 0 ? fps : 30.0;
+    // Network streams often report no frame size either, the sink is opened for the first captured frame
+    std::unique_ptr<FrameSink> sink;
+
+    // Phases as in runPipeline plus the capture-to-written latency of every frame
+    std::vector<std::string> phaseNames = pipelinePhaseNames(pipeline);
+    size_t encodePhase = phaseNames.size() - 1;
+    size_t latencyPhase = phaseNames.size();
+    phaseNames.push_back("latency");
+    PipelineStats stats(phaseNames, 0, outputPath, false);
+
+    // Skip and lower-quality keep every frame while they catch up, the hard limit only guards against a
+    // source that stays faster than the encoder
+    size_t waitingLimit = options.dropPolicy == DropPolicy::DropOldest ? options.maxQueuedFrames
+                                                                       : std::max<size_t>(8, 4 * options.maxQueuedFrames);
+    LiveQueue queue(waitingLimit);
+    std::atomic<int> captured(0);
+    std::atomic<int> dropped(0);
+
+    interrupted = false;
+    void (*previousHandler)(int) = std::signal(SIGINT, onInterrupt);
+
+    std::cout << "Live processing " << source << " (" << policyName(options.dropPolicy) << ", up to " << options.maxQueuedFrames
+              << " frame(s) behind), Ctrl+C to stop..." << std::endl;
+
+    Clock::time_point start = Clock::now();
+    std::thread capture([&]() {
+        int index = 0;
+        while (!interrupted) {
+            if (options.realTime && fps > 0) {
+                // Hold each frame back until the moment a camera would have delivered it
+                auto due = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(index / fps));
+                std::this_thread::sleep_until(start + due);
+            }
+            LiveFrame frame;
+            frame.image = queue.takeBuffer();
+            Clock::time_point readStart = Clock::now();
+            if (!cap.read(frame.image)) {
+                break;
+            }
+            frame.captured = Clock::now();
+            stats.recordPhase(0, readStart, frame.captured);
+            index++;
+            captured++;
+            dropped += static_cast<int>(queue.push(frame));
+
+            if (options.duration > 0 && std::chrono::duration<double>(frame.captured - start).count() >= options.duration) {
+                break;
+            }
+        }
+        queue.close();
+    });
+
+    FramePool pool;
+    std::vector<cv::Mat> buffers(pipeline.stages.size() + 1);
+    cv::Mat lastOutput;
+    int skipped = 0;
+    int degraded = 0;
+    double lastEncodeSeconds = 0;
+    bool sinkFailed = false;
+    Clock::time_point lastReport = start;
+
+    LiveFrame frame;
+    size_t backlog = 0;
+    while (queue.pop(frame, backlog)) {
+        if (!sink) {
+            sink = openFrameSink(outputPath, codec, outputFps, pipelineOutputSize(pipeline, frame.image.size()));
+            if (!sink) {
+                sinkFailed = true;
+                interrupted = true;
+                break;
+            }
+        }
+
+        bool behind = backlog >= options.maxQueuedFrames;
+        const cv::Mat* output;
+        if (behind && options.dropPolicy == DropPolicy::SkipProcessing && !lastOutput.empty()) {
+            skipped++;
+            // Repeat the last finished frame to keep the output cadence, unless the encoder itself cannot keep
+            // up with the frame rate, then the repeat would only add to the backlog and is dropped instead
+            if (lastEncodeSeconds * outputFps >= 1.0) {
+                dropped++;
+                queue.recycle(frame.image);
+                continue;
+            }
+            output = &lastOutput;
+        } else {
+            bool cheaper = behind && options.dropPolicy == DropPolicy::LowerQuality;
+            degraded += cheaper ? 1 : 0;
+            buffers[0] = frame.image;
+            double timestamp = std::chrono::duration<double>(frame.captured - start).count();
+            cv::Mat& result = applyPipelineStages(pipeline, buffers, pool, timestamp, stats, cheaper);
+            output = &result;
+            if (options.dropPolicy == DropPolicy::SkipProcessing) {
+                // Keep the result for repeats by trading buffers instead of copying it: the previous output
+                // takes its place and is overwritten by the next capture or stage run
+                cv::swap(lastOutput, result.data == frame.image.data ? frame.image : result);
+                output = &lastOutput;
+            }
+        }
+
+        Clock::time_point encodeStart = Clock::now();
+        sink->write(*output);
+        Clock::time_point written = Clock::now();
+        lastEncodeSeconds = std::chrono::duration<double>(written - encodeStart).count();
+        stats.recordPhase(encodePhase, encodeStart, written);
+        stats.recordPhase(latencyPhase, frame.captured, written);
+        stats.frameWritten(0);
+
+        buffers[0].release();
+        queue.recycle(frame.image);
+
+        if (options.reportInterval > 0 && std::chrono::duration<double>(written - lastReport).count() >= options.reportInterval) {
+            lastReport = written;
+            PhaseSummary latency = stats.phaseSummaries()[latencyPhase];
+            std::cout << "Live [" << outputPath << "]: " << captured << " captured, " << stats.framesWritten() << " written, "
+                      << dropped << " dropped, " << skipped << " skipped, " << degraded << " degraded, latency p50 " << latency.p50Ms
+                      << " ms p99 " << latency.p99Ms << " ms" << std::endl;
+        }
+    }
+    capture.join();
+    std::signal(SIGINT, previousHandler);
+    if (sinkFailed) {
+        return false;
+    }
+
+    PhaseSummary latency = stats.phaseSummaries()[latencyPhase];
+    std::cout << "Live processing stopped after " << stats.elapsedSeconds() << " s: " << captured << " frames captured, "
+              << stats.framesWritten() << " written, " << dropped << " dropped, " << skipped << " skipped, " << degraded
+              << " degraded. Latency p50 " << latency.p50Ms << " ms, p99 " << latency.p99Ms << " ms, max " << latency.maxMs << " ms"
+              << std::endl;
+
+    if (!options.statsPath.empty()) {
+        std::string fields = "\"input\":\"" + jsonEscape(source) + "\",\"output\":\"" + jsonEscape(outputPath) + "\",\"policy\":\"" +
+                             policyName(options.dropPolicy) + "\",\"captured\":" + std::to_string(captured) +
+                             ",\"dropped\":" + std::to_string(dropped) + ",\"skipped\":" + std::to_string(skipped) +
+                             ",\"degraded\":" + std::to_string(degraded) + ",";
+        appendStatsRecord(stats, options.statsPath, fields);
+    }
+    return true;
+}
@@ -2,8 +2,14 @@
 #include <string>    // Needed for std::string
 #include <sys/stat.h> // For mkdir
 #include <unistd.h>   // For access
-#include <cstdio>     // For std::remove (to delete files)
+#include <thread>     // For std::thread::hardware_concurrency
+#include <cstdlib>    // For std::atoi
+#include <vector>     // For the job list
+#include <memory>     // For std::unique_ptr
 #include "video_processing.h"  // Your project-specific header file
+#include "frame_pipeline.h"    // Fused single-pass pipeline
+#include "batch_runner.h"      // Non-interactive jobs and manifests
+#include "live_processing.h"   // Cameras and streams with bounded latency
 #include <opencv2/opencv.hpp>  // Include OpenCV header
 
 // Helper function to check if a directory exists
@@ -16,6 +22,232 @@ void createDirectory(const std::string& path) {
     mkdir(path.c_str(), 0777);  // Permissions: rwxrwxrwx
 }
 
+// Usage of the non-interactive mode
+void printUsage() {
+    std::cerr << "Usage: ./VideoProcessingApp <video file path>                 (interactive)" << std::endl;
+    std::cerr << "       ./VideoProcessingApp <video file path> [options]       (single job)" << std::endl;
+    std::cerr << "       ./VideoProcessingApp --manifest <jobs.csv> [options]   (batch)" << std::endl;
+    std::cerr << "Operations, applied in the order given:" << std::endl;
+    std::cerr << "  --resize WxH  --trim START:END  --rotate DEG[,crop|expand]  --text X,Y,TEXT  --grayscale  --blur" << std::endl;
+    std::cerr << "  --ops CHAIN   chain such as \"trim=2:10;resize=640x480;blur=31,box\"" << std::endl;
+    std::cerr << "                also timedtext=START:END,X,Y,TEXT and watermark=X,Y,OPACITY,PATH" << std::endl;
+    std::cerr << "  --thumbnails COUNT[,WIDTH|WxH][,even|scene][,sheet|frames]   images instead of a video, e.g. -o sheet.jpg" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --output PATH   output file (default ../output/processedVideo_final.<format>)" << std::endl;
+    std::cerr << "  --format FMT    avi, mp4 or mov when --output is not given (default avi)" << std::endl;
+    std::cerr << "  --threads N     transform threads per job" << std::endl;
+    std::cerr << "  --segments N    split each job into N parallel segments" << std::endl;
+    std::cerr << "  --jobs N        jobs run at the same time in manifest mode (default: one per core)" << std::endl;
+    std::cerr << "  --progress S    print frames, fps, ETA and queue depths every S seconds" << std::endl;
+    std::cerr << "  --stats PATH    append a JSON stats record per job to PATH (- for stdout)" << std::endl;
+    std::cerr << "  --trace PATH    write a Chrome trace-event file (single job)" << std::endl;
+    std::cerr << "  --queue N       frames buffered between pipeline threads (default 8), bounds streaming latency" << std::endl;
+    std::cerr << "  --skip-unchanged T  reuse the last output for frames whose 16x16 block averages differ by at most T (e.g. 2)" << std::endl;
+    std::cerr << "  --checkpoint S  checkpoint every S seconds of video; rerunning a killed job resumes where it stopped" << std::endl;
+    std::cerr << "  --cache DIR     reuse outputs of earlier runs with the same input contents, operations and codec" << std::endl;
+    std::cerr << "  --cache-size MB evict least recently used cache entries beyond this size (default 4096)" << std::endl;
+    std::cerr << "Live sources (camera index, stream URL, device, or a file with --realtime):" << std::endl;
+    std::cerr << "  --live          capture on its own thread and keep latency bounded by dropping frames" << std::endl;
+    std::cerr << "  --realtime      replay a file at its own frame rate as a live source" << std::endl;
+    std::cerr << "  --drop POLICY   oldest (default), skip (repeat last frame) or quality (cheaper stages) when behind" << std::endl;
+    std::cerr << "  --max-behind N  frames allowed to wait before the drop policy applies (default 2)" << std::endl;
+    std::cerr << "  --duration S    stop live processing after S seconds" << std::endl;
+    std::cerr << "Streaming: use - as the input to read stdin and -o - to write raw BGR24 frames to stdout." << std::endl;
+    std::cerr << "  --raw-size WxH  stdin carries raw BGR24 frames of this size instead of a container stream" << std::endl;
+    std::cerr << "  --fps N         frame rate of raw stdin frames (default 30)" << std::endl;
+    std::cerr << "Manifest lines are input,output,operations. Exit code is 0 when every job succeeds, 1 otherwise." << std::endl;
+}
+
+// Non-interactive mode driven by command-line flags, returns the process exit code
+int runCommandLine(int argc, char* argv[]) {
+    std::string videoPath;
+    std::string manifestPath;
+    std::string outputPath;
+    std::string format = "avi";
+    std::string operations;
+    int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int threads = -1;
+    int jobs = cores;
+    int segments = 1;
+    double progress = 0;
+    std::string statsPath;
+    std::string tracePath;
+    RawVideoFormat rawInput;
+    int queueCapacity = 0;
+    bool live = false;
+    LiveOptions liveOptions;
+    std::string cacheDirectory;
+    double cacheMegabytes = 4096;
+    double checkpointSeconds = 0;
+    double unchangedThreshold = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        } else if (arg == "--grayscale" || arg == "--blur") {
+            operations += arg.substr(2) + ";";
+        } else if (arg == "--live") {
+            live = true;
+        } else if (arg == "--realtime") {
+            live = true;
+            liveOptions.realTime = true;
+        } else if (arg == "-" || arg[0] != '-') {
+            if (!videoPath.empty()) {
+                std::cerr << "Error: More than one input video given." << std::endl;
+                return 2;
+            }
+            videoPath = arg;
+        } else if (!hasValue) {
+            std::cerr << "Error: Missing value for " << arg << std::endl;
+            printUsage();
+            return 2;
+        } else if (arg == "--resize" || arg == "--trim" || arg == "--rotate" || arg == "--text" || arg == "--thumbnails") {
+            operations += arg.substr(2) + "=" + argv[++i] + ";";
+        } else if (arg == "--ops") {
+            operations += std::string(argv[++i]) + ";";
+        } else if (arg == "--manifest") {
+            manifestPath = argv[++i];
+        } else if (arg == "--output" || arg == "-o") {
+            outputPath = argv[++i];
+        } else if (arg == "--format") {
+            format = argv[++i];
+        } else if (arg == "--threads") {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--segments") {
+            segments = std::atoi(argv[++i]);
+        } else if (arg == "--jobs") {
+            jobs = std::atoi(argv[++i]);
+        } else if (arg == "--progress") {
+            progress = std::atof(argv[++i]);
+        } else if (arg == "--stats") {
+            statsPath = argv[++i];
+        } else if (arg == "--trace") {
+            tracePath = argv[++i];
+        } else if (arg == "--raw-size") {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            rawInput.size = x == std::string::npos ? cv::Size() : cv::Size(std::atoi(size.c_str()), std::atoi(size.c_str() + x + 1));
+            if (rawInput.size.width <= 0 || rawInput.size.height <= 0) {
+                std::cerr << "Error: Invalid --raw-size " << size << ", expected WIDTHxHEIGHT" << std::endl;
+                return 2;
+            }
+        } else if (arg == "--fps") {
+            rawInput.fps = std::atof(argv[++i]);
+        } else if (arg == "--queue") {
+            queueCapacity = std::atoi(argv[++i]);
+        } else if (arg == "--skip-unchanged") {
+            unchangedThreshold = std::atof(argv[++i]);
+        } else if (arg == "--checkpoint") {
+            checkpointSeconds = std::atof(argv[++i]);
+        } else if (arg == "--cache") {
+            cacheDirectory = argv[++i];
+        } else if (arg == "--cache-size") {
+            cacheMegabytes = std::atof(argv[++i]);
+        } else if (arg == "--drop") {
+            std::string policy = argv[++i];
+            if (policy == "oldest") {
+                liveOptions.dropPolicy = DropPolicy::DropOldest;
+            } else if (policy == "skip") {
+                liveOptions.dropPolicy = DropPolicy::SkipProcessing;
+            } else if (policy == "quality") {
+                liveOptions.dropPolicy = DropPolicy::LowerQuality;
+            } else {
+                std::cerr << "Error: Unknown drop policy " << policy << ", expected oldest, skip or quality" << std::endl;
+                return 2;
+            }
+        } else if (arg == "--max-behind") {
+            liveOptions.maxQueuedFrames = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--duration") {
+            liveOptions.duration = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            printUsage();
+            return 2;
+        }
+    }
+
+    // Raw frames own stdout when streaming, so every message goes to stderr instead
+    if (outputPath == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    if ((videoPath == "-" || outputPath == "-") && segments > 1) {
+        std::cerr << "Warning: Streams cannot be split into segments, processing as one piece." << std::endl;
+        segments = 1;
+    }
+
+    std::vector<JobSpec> jobList;
+    std::string error;
+    BatchOptions options;
+    options.segments = segments;
+    options.pipeline.verbose = false;
+    options.pipeline.progressInterval = progress;
+    options.pipeline.statsPath = statsPath;
+    options.pipeline.tracePath = tracePath;
+    options.pipeline.rawInput = rawInput;
+    options.pipeline.unchangedThreshold = unchangedThreshold;
+    options.checkpointSeconds = checkpointSeconds;
+    if (queueCapacity > 0) {
+        options.pipeline.queueCapacity = static_cast<size_t>(queueCapacity);
+    }
+
+    if (!manifestPath.empty()) {
+        if (!loadManifest(manifestPath, jobList, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+        // Many short jobs keep the cores busy better than threads inside each job
+        options.concurrentJobs = std::max(1, jobs);
+        options.pipeline.workerThreads = threads > 0 ? threads : 0;
+    } else {
+        if (videoPath.empty()) {
+            std::cerr << "Error: No video file path provided." << std::endl;
+            printUsage();
+            return 2;
+        }
+        if (outputPath.empty()) {
+            if (format != "avi" && format != "mp4" && format != "mov") {
+                std::cerr << "Error: Unsupported format " << format << std::endl;
+                return 2;
+            }
+            if (!directoryExists("../output")) {
+                createDirectory("../output");
+            }
+            bool thumbnails = operations.rfind("thumbnails=", 0) == 0;
+            outputPath = thumbnails ? "../output/contactSheet.jpg" : "../output/processedVideo_final." + format;
+        }
+        JobSpec job;
+        if (!makeJob(videoPath, outputPath, operations, job, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+        if (live) {
+            if (job.thumbnails) {
+                std::cerr << "Error: Thumbnails cannot be taken from a live source." << std::endl;
+                return 2;
+            }
+            liveOptions.reportInterval = progress > 0 ? progress : liveOptions.reportInterval;
+            liveOptions.statsPath = statsPath;
+            return runLive(videoPath, outputPath, job.pipeline, job.codec, liveOptions) ? 0 : 1;
+        }
+        jobList.push_back(job);
+        options.pipeline.workerThreads = threads >= 0 ? threads : cores;
+        if (threads < 0 && segments > 1) {
+            // Segments run side by side, each with its share of the cores
+            options.pipeline.workerThreads = std::max(1, cores / std::min(cores, segments));
+        }
+    }
+
+    std::unique_ptr<ResultCache> cache;
+    if (!cacheDirectory.empty()) {
+        cache.reset(new ResultCache(cacheDirectory, static_cast<uint64_t>(std::max(0.0, cacheMegabytes) * 1024 * 1024)));
+        options.cache = cache.get();
+    }
+    return runBatch(jobList, options) == 0 ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
     // Check if the file path is provided as a command-line argument
     if (argc < 2) {
@@ -23,6 +255,11 @@ int main(int argc, char* argv[]) {
         return 1;  // Exit with error code
     }
 
+    // Any option switches to the non-interactive mode
+    if (argc > 2 || std::string(argv[1]).rfind("--", 0) == 0) {
+        return runCommandLine(argc, argv);
+    }
+
     std::string videoPath = argv[1];  // Get the file path from the command-line argument
 
     // Prompt the user for output format
@@ -48,10 +285,6 @@ int main(int argc, char* argv[]) {
         outputExtension = ".avi";
     }
 
-    std::string outputPathStep1 = "../output/processed_step1" + outputExtension;  // Intermediate output paths
-    std::string outputPathStep2 = "../output/processed_step2" + outputExtension;
-    std::string outputPathStep3 = "../output/processed_step3" + outputExtension;
-    std::string outputPathStep4 = "../output/processed_step4" + outputExtension;
     std::string finalOutputPath = "../output/processedVideo_final" + outputExtension;  // Final output video path
 
     // Check if the output folder exists, if not create it
@@ -123,42 +356,30 @@ int main(int argc, char* argv[]) {
         std::cout << "2. Blur" << std::endl;
         std::cin >> filterChoice;
 
-        // Apply all changes sequentially
-        std::cout << "Applying text overlay..." << std::endl;
-        addTextOverlay(videoPath, outputPathStep1, text, x, y, codec);  
-        std::cout << "Text overlay applied to: " << outputPathStep1 << std::endl;
-
-        std::cout << "Resizing video..." << std::endl;
-        resizeVideo(outputPathStep1, outputPathStep2, width, height, codec); 
-        std::cout << "Video resized and saved to: " << outputPathStep2 << std::endl;
-
-        std::cout << "Trimming video..." << std::endl;
-        trimVideo(outputPathStep2, outputPathStep3, startTime, endTime, codec);
-        std::cout << "Video trimmed and saved to: " << outputPathStep3 << std::endl;
-
-        std::cout << "Rotating video..." << std::endl;
-        rotateVideo(outputPathStep3, outputPathStep4, angle, codec);
-        std::cout << "Video rotated and saved to: " << outputPathStep4 << std::endl;
-
+        // Apply all changes in one decode/encode pass (trim is applied first by the pipeline)
+        FramePipeline pipeline;
+        pipeline.startTime = startTime;
+        pipeline.endTime = endTime;
+        pipeline.stages.push_back(makeTextOverlayStage(text, x, y));
+        pipeline.stages.push_back(makeResizeStage(width, height));
+        pipeline.stages.push_back(makeRotateStage(angle));
         if (filterChoice == 1) {
-            std::cout << "Applying grayscale filter..." << std::endl;
-            applyGrayscale(outputPathStep4, finalOutputPath, codec);
-            std::cout << "Grayscale filter applied and final video saved to: " << finalOutputPath << std::endl;
+            pipeline.stages.push_back(makeGrayscaleStage());
         } else if (filterChoice == 2) {
-            std::cout << "Applying blur filter..." << std::endl;
-            applyBlur(outputPathStep4, finalOutputPath, codec);
-            std::cout << "Blur filter applied and final video saved to: " << finalOutputPath << std::endl;
+            pipeline.stages.push_back(makeBlurStage());
         }
 
-        std::cout << "All changes applied. Final video saved to " << finalOutputPath << std::endl;
+        // Decode, transform and encode on separate threads, using every core for the transforms
+        PipelineOptions options;
+        options.workerThreads = static_cast<int>(std::thread::hardware_concurrency());
+        options.progressInterval = 5.0;
 
-        // Delete intermediate files after the final video is created
-        std::remove(outputPathStep1.c_str());
-        std::remove(outputPathStep2.c_str());
-        std::remove(outputPathStep3.c_str());
-        std::remove(outputPathStep4.c_str());
+        std::cout << "Applying all changes..." << std::endl;
+        if (!runPipeline(videoPath, finalOutputPath, pipeline, codec, options)) {
+            return 1;
+        }
 
-        std::cout << "Intermediate files deleted." << std::endl;
+        std::cout << "All changes applied. Final video saved to " << finalOutputPath << std::endl;
 
     } else if (mainChoice == 2) {
         // Option 2: Apply individual modifications
@@ -169,6 +390,7 @@ int main(int argc, char* argv[]) {
         std::cout << "3. Trim video" << std::endl;
         std::cout << "4. Rotate video" << std::endl;
         std::cout << "5. Apply filter" << std::endl;
+        std::cout << "6. Extract thumbnails (contact sheet)" << std::endl;
         std::cout << "Enter your choice: ";
         std::cin >> choice;
 
@@ -240,6 +462,19 @@ int main(int argc, char* argv[]) {
                 applyBlur(videoPath, finalOutputPath, codec);
                 std::cout << "Blur filter applied and saved to " << finalOutputPath << std::endl;
             }
+        } else if (choice == 6) {
+            // Extract thumbnails
+            ThumbnailOptions thumbnailOptions;
+            std::cout << "Enter the number of thumbnails: ";
+            std::cin >> thumbnailOptions.count;
+            std::cout << "Enter the thumbnail width: ";
+            std::cin >> thumbnailOptions.width;
+
+            std::string sheetPath = "../output/contactSheet.jpg";
+            if (!extractThumbnails(videoPath, sheetPath, thumbnailOptions)) {
+                return 1;
+            }
+            std::cout << "Contact sheet saved to " << sheetPath << std::endl;
         } else {
             std::cerr << "Invalid choice. Exiting..." << std::endl;
             return 1;
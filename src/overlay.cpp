@@ -0,0 +1,109 @@
+#include "overlay.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+
+void OverlayCompositor::addText(const std::string& text, int x, int y, double startTime, double endTime) {
+    const int font = cv::FONT_HERSHEY_SIMPLEX;
+    const double scale = 1.0;
+    const int thickness = 3;
+
+    // Render the glyphs once into a mask with room for the stroke width around the text box
+    int baseline = 0;
+    cv::Size textSize = cv::getTextSize(text, font, scale, thickness, &baseline);
+    int padding = thickness + 2;
+    cv::Rect rect(x - padding, y - textSize.height - padding, textSize.width + 2 * padding, textSize.height + baseline + 2 * padding);
+
+    OverlayLayer layer;
+    layer.rect = rect;
+    layer.mask = cv::Mat::zeros(rect.height, rect.width, CV_8UC1);
+    cv::putText(layer.mask, text, cv::Point(x - rect.x, y - rect.y), font, scale, cv::Scalar(255), thickness);
+    layer.color = cv::Mat(rect.height, rect.width, CV_8UC3, cv::Scalar(0, 0, 255));
+    layer.opaque = true;
+    layer.startTime = startTime;
+    layer.endTime = endTime;
+    layers.push_back(layer);
+}
+
+bool OverlayCompositor::addImage(const std::string& imagePath, int x, int y, double opacity, double startTime, double endTime) {
+    cv::Mat image = cv::imread(imagePath, cv::IMREAD_UNCHANGED);
+    if (image.empty() || image.depth() != CV_8U) {
+        return false;
+    }
+
+    OverlayLayer layer;
+    layer.rect = cv::Rect(x, y, image.cols, image.rows);
+    cv::Mat coverage;
+    if (image.channels() == 4) {
+        cv::cvtColor(image, layer.color, cv::COLOR_BGRA2BGR);
+        cv::extractChannel(image, coverage, 3);
+    } else if (image.channels() == 3) {
+        layer.color = image;
+        coverage = cv::Mat(image.rows, image.cols, CV_8UC1, cv::Scalar(255));
+    } else {
+        cv::cvtColor(image, layer.color, cv::COLOR_GRAY2BGR);
+        coverage = cv::Mat(image.rows, image.cols, CV_8UC1, cv::Scalar(255));
+    }
+    opacity = std::min(1.0, std::max(0.0, opacity));
+    coverage.convertTo(coverage, CV_8U, opacity);
+
+    // Without partial coverage a masked copy is enough, which is also what text layers use
+    cv::Mat partial;
+    cv::inRange(coverage, cv::Scalar(1), cv::Scalar(254), partial);
+    layer.opaque = cv::countNonZero(partial) == 0;
+    if (layer.opaque) {
+        layer.mask = coverage;
+    } else {
+        // The colour term of the blend is fixed, so it is weighted once here and each frame only scales
+        // the pixels underneath and adds it
+        cv::Mat channels[] = {coverage, coverage, coverage};
+        cv::Mat alpha;
+        cv::merge(channels, 3, alpha);
+        cv::multiply(layer.color, alpha, layer.weightedColor, 1.0 / 255.0);
+        cv::subtract(cv::Scalar::all(255), alpha, layer.inverseAlpha);
+    }
+    layer.startTime = startTime;
+    layer.endTime = endTime;
+    layers.push_back(layer);
+    return true;
+}
+
+void OverlayCompositor::apply(cv::Mat& frame, double timestamp) const {
+    cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    for (const OverlayLayer& layer : layers) {
+        if (layer.startTime >= 0 && timestamp < layer.startTime) {
+            continue;
+        }
+        if (layer.endTime >= 0 && timestamp > layer.endTime) {
+            continue;
+        }
+
+        // Only the part of the layer that falls inside the frame is composited
+        cv::Rect visible = layer.rect & frameRect;
+        if (visible.empty()) {
+            continue;
+        }
+        cv::Rect local(visible.x - layer.rect.x, visible.y - layer.rect.y, visible.width, visible.height);
+
+        cv::Mat target = frame(visible);
+        if (layer.opaque) {
+            layer.color(local).copyTo(target, layer.mask(local));
+        } else {
+            // dst = dst * (255 - alpha) / 255 + color * alpha / 255, in place with OpenCV's SIMD kernels
+            cv::multiply(target, layer.inverseAlpha(local), target, 1.0 / 255.0);
+            cv::add(target, layer.weightedColor(local), target);
+        }
+    }
+}
+
+bool OverlayCompositor::isTimed() const {
+    for (const OverlayLayer& layer : layers) {
+        if (layer.startTime >= 0 || layer.endTime >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OverlayCompositor::empty() const {
+    return layers.empty();
+}
@@ -0,0 +1,210 @@
+#include "pipeline_stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+PipelineStats::PipelineStats(const std::vector<std::string>& phaseNames, int expectedFrames, const std::string& runLabel, bool keepTrace)
+    : names(phaseNames), expected(expectedFrames), label(runLabel), trace(keepTrace), startTime(Clock::now()), samples(phaseNames.size()),
+      written(0), lastProgress(startTime) {}
+
+int PipelineStats::threadNumber() {
+    // Called with the mutex held; trace viewers want small stable thread ids
+    auto it = threads.find(std::this_thread::get_id());
+    if (it == threads.end()) {
+        it = threads.emplace(std::this_thread::get_id(), static_cast<int>(threads.size()) + 1).first;
+    }
+    return it->second;
+}
+
+void PipelineStats::recordPhase(size_t phase, const Clock::time_point& start, const Clock::time_point& end) {
+    double durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    samples[phase].push_back(static_cast<float>(durationMs));
+    if (trace) {
+        double startUs = std::chrono::duration<double, std::micro>(start - startTime).count();
+        events.push_back(TraceEvent{phase, threadNumber(), startUs, durationMs * 1000.0});
+    }
+}
+
+void PipelineStats::sampleQueues(size_t decodedDepth, size_t decodedCapacity, size_t processedDepth, size_t processedCapacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queueSamples++;
+    decodedSum += decodedDepth;
+    processedSum += processedDepth;
+    decodedQueue.capacity = decodedCapacity;
+    decodedQueue.max = std::max(decodedQueue.max, decodedDepth);
+    decodedQueue.mean = decodedSum / queueSamples;
+    processedQueue.capacity = processedCapacity;
+    processedQueue.max = std::max(processedQueue.max, processedDepth);
+    processedQueue.mean = processedSum / queueSamples;
+}
+
+void PipelineStats::frameWritten(double interval) {
+    int frames = ++written;
+    if (interval <= 0) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (std::chrono::duration<double>(now - lastProgress).count() >= interval) {
+        lastProgress = now;
+        printProgress(frames);
+    }
+}
+
+int PipelineStats::framesWritten() const {
+    return written;
+}
+
+double PipelineStats::elapsedSeconds() const {
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+void PipelineStats::printProgress(int frames) const {
+    double elapsed = elapsedSeconds();
+    double fps = elapsed > 0 ? frames / elapsed : 0.0;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << "Progress [" << label << "]: " << frames;
+    if (expected > 0) {
+        line << "/" << expected << " frames (" << 100.0 * frames / expected << "%)";
+    } else {
+        line << " frames";
+    }
+    line << ", " << fps << " fps";
+    if (expected > 0 && fps > 0) {
+        line << ", ETA " << std::max(0, expected - frames) / fps << " s";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queueSamples > 0) {
+        line << ", queues decoded " << decodedQueue.mean << "/" << decodedQueue.capacity << " processed " << processedQueue.mean << "/"
+             << processedQueue.capacity;
+    }
+    std::cout << line.str() << std::endl;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<float>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+std::vector<PhaseSummary> PipelineStats::phaseSummaries() const {
+    std::vector<PhaseSummary> summaries;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < names.size(); i++) {
+        std::vector<float> sorted = samples[i];
+        std::sort(sorted.begin(), sorted.end());
+
+        PhaseSummary summary;
+        summary.name = names[i];
+        summary.count = sorted.size();
+        for (float sample : sorted) {
+            summary.totalMs += sample;
+        }
+        if (!sorted.empty()) {
+            summary.meanMs = summary.totalMs / sorted.size();
+            summary.maxMs = sorted.back();
+        }
+        summary.p50Ms = percentile(sorted, 0.50);
+        summary.p90Ms = percentile(sorted, 0.90);
+        summary.p99Ms = percentile(sorted, 0.99);
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+void PipelineStats::writeJson(std::ostream& out, const std::string& extraFields) const {
+    double elapsed = elapsedSeconds();
+    int frames = written;
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3) << "{" << extraFields << "\"frames\":" << frames << ",\"expected_frames\":" << expected
+         << ",\"elapsed_s\":" << elapsed << ",\"fps\":" << (elapsed > 0 ? frames / elapsed : 0.0) << ",\"phases\":[";
+    std::vector<PhaseSummary> summaries = phaseSummaries();
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const PhaseSummary& phase = summaries[i];
+        json << (i > 0 ? "," : "") << "{\"name\":\"" << jsonEscape(phase.name) << "\",\"count\":" << phase.count
+             << ",\"total_ms\":" << phase.totalMs << ",\"mean_ms\":" << phase.meanMs << ",\"p50_ms\":" << phase.p50Ms
+             << ",\"p90_ms\":" << phase.p90Ms << ",\"p99_ms\":" << phase.p99Ms << ",\"max_ms\":" << phase.maxMs << "}";
+    }
+    json << "]";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queueSamples > 0) {
+        json << ",\"queues\":{\"decoded\":{\"capacity\":" << decodedQueue.capacity << ",\"mean\":" << decodedQueue.mean
+             << ",\"max\":" << decodedQueue.max << "},\"processed\":{\"capacity\":" << processedQueue.capacity
+             << ",\"mean\":" << processedQueue.mean << ",\"max\":" << processedQueue.max << "}}";
+    }
+    json << "}";
+    out << json.str() << std::endl;
+}
+
+bool PipelineStats::writeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not write trace file " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file << std::fixed << std::setprecision(1) << "{\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& event = events[i];
+        file << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << jsonEscape(names[event.phase]) << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << event.thread << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    return static_cast<bool>(file);
+}
+
+void appendStatsRecord(const PipelineStats& stats, const std::string& statsPath, const std::string& fields) {
+    static std::mutex fileMutex;
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (statsPath == "-") {
+        stats.writeJson(std::cout, fields);
+        return;
+    }
+    std::ofstream file(statsPath, std::ios::app);
+    if (!file) {
+        std::cerr << "Error: Could not write stats file " << statsPath << std::endl;
+        return;
+    }
+    stats.writeJson(file, fields);
+}
@@ -0,0 +1,170 @@
+#include "result_cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Bumped whenever processing changes in a way that makes older cached outputs wrong
+static const char* cacheFormatVersion = "vp-cache-1";
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string toHex(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+ResultCache::ResultCache(const std::string& directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+}
+
+std::string ResultCache::fileDigest(const std::string& path) {
+    std::error_code error;
+    uint64_t size = fs::file_size(path, error);
+    if (error) {
+        return "";
+    }
+    int64_t modified = static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+    auto id = std::make_tuple(path, size, modified);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = digests.find(id);
+        if (it != digests.end()) {
+            return it->second;
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return "";
+    }
+    std::vector<char> buffer(1 << 20);
+    uint64_t hash = fnv1a(nullptr, 0);
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        hash = fnv1a(buffer.data(), static_cast<size_t>(file.gcount()), hash);
+    }
+    std::string digest = toHex(hash);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    digests[id] = digest;
+    return digest;
+}
+
+std::string ResultCache::key(const std::string& inputDigest, const std::string& chain, int codec, const std::string& extension) const {
+    std::string description = std::string(cacheFormatVersion) + "\n" + inputDigest + "\n" + chain + "\n" + std::to_string(codec) + "\n" +
+                              extension;
+    return toHex(fnv1a(description.data(), description.size()));
+}
+
+std::string ResultCache::entryPath(const std::string& key, const std::string& extension) const {
+    return (fs::path(directory) / (key + extension)).string();
+}
+
+bool ResultCache::contains(const std::string& key, const std::string& extension) const {
+    std::error_code error;
+    return fs::is_regular_file(entryPath(key, extension), error);
+}
+
+bool ResultCache::fetch(const std::string& key, const std::string& extension, const std::string& outputPath) {
+    std::string entry = entryPath(key, extension);
+    std::error_code error;
+    if (!fs::is_regular_file(entry, error)) {
+        return false;
+    }
+
+    // A copy, not a link: a later job writing to outputPath truncates the file in place, which must not reach
+    // the entry. The entry may be evicted concurrently, in which case this is a miss.
+    fs::copy_file(entry, outputPath, fs::copy_options::overwrite_existing, error);
+    if (error) {
+        return false;
+    }
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool ResultCache::store(const std::string& key, const std::string& extension, const std::string& resultPath) {
+    // Copy under a temporary name and rename, so readers never see a partial entry
+    std::string entry = entryPath(key, extension);
+    std::string temporary = entry + ".tmp" + toHex(fnv1a(resultPath.data(), resultPath.size()));
+    std::error_code error;
+    fs::copy_file(resultPath, temporary, fs::copy_options::overwrite_existing, error);
+    if (!error) {
+        fs::rename(temporary, entry, error);
+    }
+    if (error) {
+        fs::remove(temporary, error);
+        std::cerr << "Warning: Could not add " << resultPath << " to the cache." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.stores++;
+    evict();
+    return true;
+}
+
+void ResultCache::evict() {
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const fs::directory_entry& item : fs::directory_iterator(directory, error)) {
+        if (!item.is_regular_file(error) || item.path().string().find(".tmp") != std::string::npos) {
+            continue;
+        }
+        Entry entry{item.path(), item.file_size(error), item.last_write_time(error)};
+        total += entry.size;
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& entry : entries) {
+        if (total <= maxBytes) {
+            break;
+        }
+        if (fs::remove(entry.path, error)) {
+            total -= entry.size;
+            counters.evictions++;
+        }
+    }
+}
+
+void ResultCache::countHit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.hits++;
+}
+
+void ResultCache::countPrefixHit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.prefixHits++;
+}
+
+void ResultCache::countMiss() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.misses++;
+}
+
+CacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
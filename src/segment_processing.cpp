@@ -0,0 +1,344 @@
+#include "segment_processing.h"
+#include "libav_io.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+std::vector<FrameRange> planSegments(int startFrame, int endFrame, int segmentCount, const std::vector<int>& keyframes) {
+    std::vector<int> boundaries{startFrame};
+    long long length = static_cast<long long>(endFrame) - startFrame + 1;
+    for (int i = 1; i < segmentCount; i++) {
+        int boundary = startFrame + static_cast<int>(length * i / segmentCount);
+        if (!keyframes.empty()) {
+            // Start segments on keyframes so no segment decodes frames that belong to the previous one
+            auto it = std::lower_bound(keyframes.begin(), keyframes.end(), boundary);
+            if (it == keyframes.end()) {
+                break;
+            }
+            boundary = *it;
+        }
+        if (boundary > boundaries.back() && boundary <= endFrame) {
+            boundaries.push_back(boundary);
+        }
+    }
+
+    std::vector<FrameRange> segments;
+    for (size_t i = 0; i < boundaries.size(); i++) {
+        FrameRange range;
+        range.start = boundaries[i];
+        range.end = i + 1 < boundaries.size() ? boundaries[i + 1] - 1 : endFrame;
+        segments.push_back(range);
+    }
+    return segments;
+}
+
+std::string segmentPath(const std::string& outputPath, int index) {
+    size_t slash = outputPath.find_last_of('/');
+    size_t dot = outputPath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return outputPath + ".part" + std::to_string(index);
+    }
+    return outputPath.substr(0, dot) + ".part" + std::to_string(index) + outputPath.substr(dot);
+}
+
+bool joinSegments(const std::vector<std::string>& segmentPaths, const std::string& outputPath, int codec) {
+    if (concatVideos(segmentPaths, outputPath)) {
+        return true;
+    }
+
+    // Without libav the segments are decoded and written again into a single file
+    std::cout << "Joining segments by re-encoding..." << std::endl;
+    cv::VideoWriter writer;
+    cv::Mat frame;
+    for (const std::string& path : segmentPaths) {
+        cv::VideoCapture cap(path);
+        if (!cap.isOpened()) {
+            std::cerr << "Error: Could not open segment " << path << " for joining." << std::endl;
+            return false;
+        }
+        if (!writer.isOpened()) {
+            int width = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+            int height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+            if (!writer.open(outputPath, codec, cap.get(cv::CAP_PROP_FPS), cv::Size(width, height))) {
+                std::cerr << "Error: Could not open output video file for joining segments." << std::endl;
+                return false;
+            }
+        }
+        while (cap.read(frame)) {
+            writer.write(frame);
+        }
+    }
+    return true;
+}
+
+bool runPipelineSegmented(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                          int segmentCount, const PipelineOptions& options) {
+    // Standard input and output are streams, they cannot be split into independent pieces
+    if (inputPath == "-" || outputPath == "-") {
+        return runPipeline(inputPath, outputPath, pipeline, codec, options);
+    }
+
+    std::cout << "Preparing segmented processing..." << std::endl;
+
+    cv::VideoCapture cap(inputPath);
+    if (!cap.isOpened()) {
+        std::cerr << "Error: Could not open video file for processing." << std::endl;
+        return false;
+    }
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    cap.release();
+
+    int startFrame, endFrame;
+    if (!pipelineFrameRange(pipeline, fps, totalFrames, startFrame, endFrame)) {
+        std::cerr << "Error: Invalid start or end time for trimming." << std::endl;
+        return false;
+    }
+
+    // Splitting needs a known length, otherwise process the video as one piece
+    if (totalFrames <= 0 || segmentCount <= 1) {
+        return runPipeline(inputPath, outputPath, pipeline, codec, options);
+    }
+
+    std::vector<FrameRange> segments = planSegments(startFrame, endFrame, segmentCount, buildKeyframeIndex(inputPath));
+
+    PipelineOptions segmentOptions = options;
+    // Progress lines and stats records come per segment, a trace file would be overwritten by every segment
+    segmentOptions.verbose = false;
+    segmentOptions.tracePath.clear();
+
+    // Every segment decodes, transforms and encodes on its own, and with worker threads each one runs
+    // that many more, so the segments in flight share the cores instead of one thread each
+    int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int threadsPerSegment = std::max(1, options.workerThreads);
+    int threadCount = std::max(1, std::min(cores / threadsPerSegment, static_cast<int>(segments.size())));
+    std::cout << "Processing " << segments.size() << " segment(s), " << threadCount << " at a time..." << std::endl;
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < segments.size(); i++) {
+        paths.push_back(segmentPath(outputPath, static_cast<int>(i)));
+    }
+
+    std::atomic<size_t> nextSegment(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = nextSegment++; i < segments.size() && !failed; i = nextSegment++) {
+                if (!runPipelineFrames(inputPath, paths[i], pipeline, codec, segments[i].start, segments[i].end, segmentOptions)) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    bool ok = !failed;
+    if (ok) {
+        std::cout << "Joining " << paths.size() << " segment(s)..." << std::endl;
+        ok = joinSegments(paths, outputPath, codec);
+    }
+
+    for (const std::string& path : paths) {
+        std::remove(path.c_str());
+    }
+
+    if (ok) {
+        std::cout << "Segmented processing complete. Output saved to " << outputPath << std::endl;
+    }
+    return ok;
+}
+
+std::string resumeDirectory(const std::string& outputPath) {
+    return outputPath + ".resume";
+}
+
+// One line identifying everything that determines the segments' contents
+static std::string checkpointSignature(const std::string& inputPath, int codec, int startFrame, int endFrame,
+                                       const std::vector<FrameRange>& segments, const ResumeOptions& options) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(inputPath, error);
+    auto modified = std::filesystem::last_write_time(inputPath, error).time_since_epoch().count();
+    std::string signature = "input=" + inputPath + ";size=" + std::to_string(size) + ";mtime=" + std::to_string(modified) +
+                            ";codec=" + std::to_string(codec) + ";frames=" + std::to_string(startFrame) + "-" + std::to_string(endFrame) +
+                            ";segments=" + std::to_string(segments.size()) + ";ops=" + options.signature;
+    std::replace(signature.begin(), signature.end(), '\n', ' ');
+    return signature;
+}
+
+// Segments listed as done by a checkpoint written with the same signature
+static std::set<size_t> readCheckpoint(const std::string& checkpointPath, const std::string& signature,
+                                       const std::vector<std::string>& paths) {
+    std::set<size_t> done;
+    std::ifstream checkpoint(checkpointPath);
+    std::string line;
+    if (!std::getline(checkpoint, line) || line != "signature " + signature) {
+        return done;
+    }
+    while (std::getline(checkpoint, line)) {
+        // A line cut short by the kill has no newline and is ignored, its segment is processed again
+        if (checkpoint.eof()) {
+            break;
+        }
+        // "done INDEX BYTES": the segment only counts when its file still has the size it had when it finished
+        std::istringstream fields(line);
+        std::string word;
+        size_t index = 0;
+        uintmax_t bytes = 0;
+        std::error_code error;
+        if ((fields >> word >> index >> bytes) && word == "done" && index < paths.size() &&
+            std::filesystem::file_size(paths[index], error) == bytes && !error) {
+            done.insert(index);
+        }
+    }
+    return done;
+}
+
+// Forces a finished file and the directory entry naming it to disk
+static bool syncFile(const std::string& path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    bool ok = fsync(file) == 0;
+    close(file);
+
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int folder = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (folder >= 0) {
+        fsync(folder);
+        close(folder);
+    }
+    return ok;
+}
+
+// Appends a line and forces it to disk, so a checkpoint survives the machine going away as well
+static void appendCheckpoint(std::FILE* checkpoint, const std::string& line) {
+    std::fputs((line + "\n").c_str(), checkpoint);
+    std::fflush(checkpoint);
+    fsync(fileno(checkpoint));
+}
+
+bool runPipelineResumable(const std::string& inputPath, const std::string& outputPath, const FramePipeline& pipeline, int codec,
+                          const ResumeOptions& options) {
+    cv::VideoCapture cap(inputPath);
+    if (!cap.isOpened()) {
+        std::cerr << "Error: Could not open video file for processing." << std::endl;
+        return false;
+    }
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    cap.release();
+
+    int startFrame, endFrame;
+    if (!pipelineFrameRange(pipeline, fps, totalFrames, startFrame, endFrame)) {
+        std::cerr << "Error: Invalid start or end time for trimming." << std::endl;
+        return false;
+    }
+    // Checkpoints need a known length to plan segments
+    if (totalFrames <= 0 || fps <= 0) {
+        std::cerr << "Warning: Video length unknown, processing without checkpoints." << std::endl;
+        return runPipeline(inputPath, outputPath, pipeline, codec, options.pipeline);
+    }
+
+    double segmentFrames = std::max(1.0, options.checkpointSeconds * fps);
+    int segmentCount = static_cast<int>(std::ceil((endFrame - startFrame + 1) / segmentFrames));
+    std::vector<FrameRange> segments = planSegments(startFrame, endFrame, std::max(1, segmentCount), buildKeyframeIndex(inputPath));
+
+    std::string directory = resumeDirectory(outputPath);
+    std::string checkpointPath = directory + "/checkpoint";
+    std::string signature = checkpointSignature(inputPath, codec, startFrame, endFrame, segments, options);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    size_t slash = outputPath.find_last_of('/');
+    size_t dot = outputPath.find_last_of('.');
+    std::string extension = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? "" : outputPath.substr(dot);
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < segments.size(); i++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/part%04zu", i);
+        paths.push_back(directory + name + extension);
+    }
+
+    std::set<size_t> done = readCheckpoint(checkpointPath, signature, paths);
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (!done.count(i)) {
+            pending.push_back(i);
+        }
+    }
+
+    std::FILE* checkpoint = nullptr;
+    if (done.empty()) {
+        checkpoint = std::fopen(checkpointPath.c_str(), "w");
+        if (checkpoint) {
+            appendCheckpoint(checkpoint, "signature " + signature);
+        }
+    } else {
+        std::cout << "Resuming from checkpoint: " << segments.size() - pending.size() << " of " << segments.size()
+                  << " segment(s) already done" << std::endl;
+        checkpoint = std::fopen(checkpointPath.c_str(), "a");
+    }
+    if (!checkpoint) {
+        std::cerr << "Error: Could not write checkpoint " << checkpointPath << std::endl;
+        return false;
+    }
+
+    PipelineOptions segmentOptions = options.pipeline;
+    // Progress lines and stats records come per segment, a trace file would be overwritten by every segment
+    segmentOptions.verbose = false;
+    segmentOptions.tracePath.clear();
+
+    std::atomic<size_t> nextPending(0);
+    std::atomic<size_t> finished(segments.size() - pending.size());
+    std::atomic<bool> failed(false);
+    std::mutex checkpointMutex;
+    std::vector<std::thread> threads;
+    int threadCount = std::max(1, std::min(options.parallelSegments, static_cast<int>(pending.size())));
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            for (size_t next = nextPending++; next < pending.size() && !failed; next = nextPending++) {
+                size_t i = pending[next];
+                if (!runPipelineFrames(inputPath, paths[i], pipeline, codec, segments[i].start, segments[i].end, segmentOptions) ||
+                    !syncFile(paths[i])) {
+                    failed = true;
+                    return;
+                }
+                // The segment file is closed and on disk, only now may the checkpoint list it
+                std::error_code sizeError;
+                uintmax_t bytes = std::filesystem::file_size(paths[i], sizeError);
+                std::lock_guard<std::mutex> lock(checkpointMutex);
+                appendCheckpoint(checkpoint, "done " + std::to_string(i) + " " + std::to_string(bytes));
+                std::cout << "Checkpoint: " << ++finished << " of " << segments.size() << " segment(s) done" << std::endl;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    std::fclose(checkpoint);
+
+    // The work directory stays behind on failure so the next run resumes from it
+    if (failed || !joinSegments(paths, outputPath, codec)) {
+        std::cerr << "Error: Processing stopped, rerun the same job to resume from " << directory << std::endl;
+        return false;
+    }
+    std::filesystem::remove_all(directory, error);
+    std::cout << "Resumable processing complete. Output saved to " << outputPath << std::endl;
+    return true;
+}
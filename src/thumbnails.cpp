@@ -0,0 +1,175 @@
+#include "thumbnails.h"
+#include "libav_io.h"
+#include "video_processing.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// Candidates examined per thumbnail in SceneChange mode
+static const int sceneCandidatesPerThumbnail = 4;
+
+std::vector<int> selectEvenFrames(int totalFrames, int count) {
+    std::vector<int> frames;
+    for (int i = 0; i < count; i++) {
+        int target = static_cast<int>((i + 0.5) * totalFrames / count);
+        if (frames.empty() || frames.back() != target) {
+            frames.push_back(target);
+        }
+    }
+    return frames;
+}
+
+std::string thumbnailPath(const std::string& outputPath, int index) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%02d", index);
+    size_t slash = outputPath.find_last_of('/');
+    size_t dot = outputPath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return outputPath + number + ".jpg";
+    }
+    return outputPath.substr(0, dot) + number + outputPath.substr(dot);
+}
+
+// Evenly spaced frames moved back to their keyframes with one index seek each, instead of scanning every packet
+// of the file for a full keyframe index. Targets that share a keyframe are listed once.
+static std::vector<int> selectKeyframes(const std::string& inputPath, int totalFrames, int count) {
+    std::vector<int> targets = selectEvenFrames(totalFrames, count);
+    std::vector<int> keyframes = keyframesAtOrBefore(inputPath, targets);
+    if (keyframes.size() != targets.size()) {
+        return targets;
+    }
+    std::sort(keyframes.begin(), keyframes.end());
+    keyframes.erase(std::unique(keyframes.begin(), keyframes.end()), keyframes.end());
+    return keyframes;
+}
+
+// Decodes one frame and shrinks it straight away, so only thumbnail-sized images are kept. With libav the
+// targets sit on keyframes and each seek decodes a single frame; without it the seek decodes forward from the
+// keyframe before the target.
+static bool grabThumbnail(cv::VideoCapture& cap, int frameIndex, const cv::Size& size, cv::Mat& frame, cv::Mat& thumbnail) {
+    if (!seekToFrame(cap, frameIndex) || !cap.read(frame)) {
+        return false;
+    }
+    resizeFrame(frame, thumbnail, size.width, size.height);
+    return true;
+}
+
+// Mean absolute difference of two thumbnails on a coarse grayscale grid, cheap and robust to noise
+static double frameChange(const cv::Mat& previous, const cv::Mat& current) {
+    cv::Mat a, b;
+    cv::resize(previous, a, cv::Size(32, 18), 0, 0, cv::INTER_AREA);
+    cv::resize(current, b, cv::Size(32, 18), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(a, a, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(b, b, cv::COLOR_BGR2GRAY);
+    return cv::norm(a, b, cv::NORM_L1) / a.total();
+}
+
+// Tiles the thumbnails row by row on a black sheet with each one's timestamp in its corner
+static cv::Mat buildContactSheet(const std::vector<cv::Mat>& thumbnails, const std::vector<int>& frames, double fps, int columns) {
+    int count = static_cast<int>(thumbnails.size());
+    if (columns <= 0) {
+        columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    }
+    int rows = (count + columns - 1) / columns;
+    int spacing = 4;
+    cv::Size tile = thumbnails[0].size();
+
+    cv::Mat sheet(rows * (tile.height + spacing) + spacing, columns * (tile.width + spacing) + spacing, CV_8UC3, cv::Scalar(0, 0, 0));
+    for (int i = 0; i < count; i++) {
+        cv::Rect rect(spacing + (i % columns) * (tile.width + spacing), spacing + (i / columns) * (tile.height + spacing), tile.width,
+                      tile.height);
+        thumbnails[i].copyTo(sheet(rect));
+
+        if (fps > 0) {
+            int seconds = static_cast<int>(frames[i] / fps);
+            char label[32];
+            std::snprintf(label, sizeof(label), "%02d:%02d:%02d", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+            cv::putText(sheet, label, cv::Point(rect.x + 4, rect.y + rect.height - 6), cv::FONT_HERSHEY_SIMPLEX, 0.4,
+                        cv::Scalar(255, 255, 255), 1);
+        }
+    }
+    return sheet;
+}
+
+bool extractThumbnails(const std::string& inputPath, const std::string& outputPath, const ThumbnailOptions& options) {
+    cv::VideoCapture cap(inputPath);
+    if (!cap.isOpened()) {
+        std::cerr << "Error: Could not open video file for thumbnails." << std::endl;
+        return false;
+    }
+
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    int sourceWidth = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+    int sourceHeight = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if (totalFrames <= 0 || sourceWidth <= 0 || sourceHeight <= 0 || options.count <= 0 || options.width <= 0) {
+        std::cerr << "Error: Video length or size unknown, cannot place thumbnails." << std::endl;
+        return false;
+    }
+    int height = options.height > 0 ? options.height : std::max(1, options.width * sourceHeight / sourceWidth);
+    cv::Size size(options.width, height);
+
+    std::vector<int> frames;
+    std::vector<cv::Mat> thumbnails;
+    cv::Mat frame;
+    if (options.selection == ThumbnailSelection::SceneChange) {
+        std::vector<int> candidates = selectKeyframes(inputPath, totalFrames, options.count * sceneCandidatesPerThumbnail);
+        std::vector<cv::Mat> candidateImages;
+        std::vector<int> candidateFrames;
+        std::vector<std::pair<double, size_t>> scores;
+        for (int candidate : candidates) {
+            cv::Mat thumbnail;
+            if (!grabThumbnail(cap, candidate, size, frame, thumbnail)) {
+                continue;
+            }
+            double change = candidateImages.empty() ? 0.0 : frameChange(candidateImages.back(), thumbnail);
+            scores.emplace_back(change, candidateImages.size());
+            candidateImages.push_back(thumbnail);
+            candidateFrames.push_back(candidate);
+        }
+
+        // Keep the biggest changes, then put them back in time order
+        std::sort(scores.begin(), scores.end(), [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+            return a.first > b.first;
+        });
+        scores.resize(std::min(scores.size(), static_cast<size_t>(options.count)));
+        std::sort(scores.begin(), scores.end(), [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+            return a.second < b.second;
+        });
+        for (const std::pair<double, size_t>& score : scores) {
+            frames.push_back(candidateFrames[score.second]);
+            thumbnails.push_back(candidateImages[score.second]);
+        }
+    } else {
+        for (int candidate : selectKeyframes(inputPath, totalFrames, options.count)) {
+            cv::Mat thumbnail;
+            if (grabThumbnail(cap, candidate, size, frame, thumbnail)) {
+                frames.push_back(candidate);
+                thumbnails.push_back(thumbnail);
+            }
+        }
+    }
+
+    if (thumbnails.empty()) {
+        std::cerr << "Error: Could not decode any frame for thumbnails." << std::endl;
+        return false;
+    }
+
+    if (options.contactSheet) {
+        if (!cv::imwrite(outputPath, buildContactSheet(thumbnails, frames, fps, options.columns))) {
+            std::cerr << "Error: Could not write contact sheet " << outputPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+    for (size_t i = 0; i < thumbnails.size(); i++) {
+        std::string path = thumbnailPath(outputPath, static_cast<int>(i));
+        if (!cv::imwrite(path, thumbnails[i])) {
+            std::cerr << "Error: Could not write thumbnail " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
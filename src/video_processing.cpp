@@ -1,11 +1,294 @@
 #include "video_processing.h"
+#include "libav_io.h"
+#include "overlay.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// Frame kernels
+void resizeFrame(const cv::Mat& input, cv::Mat& output, int width, int height) {
+    // Area averaging is alias-free and faster when shrinking, bilinear is the better choice when enlarging
+    int interpolation = width < input.cols && height < input.rows ? cv::INTER_AREA : cv::INTER_LINEAR;
+    cv::resize(input, output, cv::Size(width, height), 0, 0, interpolation);
+}
+
+bool rotateFrame(const cv::Mat& input, cv::Mat& output, int angle) {
+    switch (angle) {
+        case 90:
+            cv::rotate(input, output, cv::ROTATE_90_CLOCKWISE);
+            return true;
+        case 180:
+            cv::rotate(input, output, cv::ROTATE_180);
+            return true;
+        case 270:
+            cv::rotate(input, output, cv::ROTATE_90_COUNTERCLOCKWISE);
+            return true;
+        default:
+            return false;
+    }
+}
+
+double normalizeRotation(double angle) {
+    angle = std::fmod(angle, 360.0);
+    return angle < 0 ? angle + 360.0 : angle;
+}
+
+RotationMaps buildRotationMaps(const cv::Size& inputSize, double angle, RotateFit fit) {
+    double radians = angle * CV_PI / 180.0;
+    double cosine = std::cos(radians);
+    double sine = std::sin(radians);
+    // Bounding box of the rotated picture
+    double boundsWidth = inputSize.width * std::abs(cosine) + inputSize.height * std::abs(sine);
+    double boundsHeight = inputSize.width * std::abs(sine) + inputSize.height * std::abs(cosine);
+
+    RotationMaps maps;
+    maps.inputSize = inputSize;
+    double scale = 1.0;
+    if (fit == RotateFit::Crop) {
+        // The smallest zoom at which the rotated picture still covers the whole frame
+        maps.outputSize = inputSize;
+        scale = std::max(boundsWidth / inputSize.width, boundsHeight / inputSize.height);
+    } else {
+        // Rounded up to even sizes, which 4:2:0 encoders require
+        maps.outputSize = cv::Size((static_cast<int>(std::ceil(boundsWidth - 1e-6)) + 1) & ~1,
+                                   (static_cast<int>(std::ceil(boundsHeight - 1e-6)) + 1) & ~1);
+    }
+
+    // Each output pixel samples the input at its position rotated back around the centres
+    double inputCenterX = (inputSize.width - 1) / 2.0;
+    double inputCenterY = (inputSize.height - 1) / 2.0;
+    double outputCenterX = (maps.outputSize.width - 1) / 2.0;
+    double outputCenterY = (maps.outputSize.height - 1) / 2.0;
+    cv::Mat mapX(maps.outputSize, CV_32FC1);
+    cv::Mat mapY(maps.outputSize, CV_32FC1);
+    for (int y = 0; y < maps.outputSize.height; y++) {
+        float* xs = mapX.ptr<float>(y);
+        float* ys = mapY.ptr<float>(y);
+        double dy = y - outputCenterY;
+        for (int x = 0; x < maps.outputSize.width; x++) {
+            double dx = x - outputCenterX;
+            xs[x] = static_cast<float>(inputCenterX + (dx * cosine + dy * sine) / scale);
+            ys[x] = static_cast<float>(inputCenterY + (dy * cosine - dx * sine) / scale);
+        }
+    }
+    cv::convertMaps(mapX, mapY, maps.coordinates, maps.weights, CV_16SC2);
+    return maps;
+}
+
+void rotateFrameWithMaps(const cv::Mat& input, cv::Mat& output, const RotationMaps& maps, bool fast) {
+    if (fast) {
+        // The integer coordinates alone give nearest-neighbour sampling
+        cv::remap(input, output, maps.coordinates, cv::Mat(), cv::INTER_NEAREST, cv::BORDER_CONSTANT);
+    } else {
+        cv::remap(input, output, maps.coordinates, maps.weights, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    }
+}
+
+bool FrameChangeDetector::unchanged(const cv::Mat& frame) {
+    cv::resize(frame, current, cv::Size(std::max(1, frame.cols / 16), std::max(1, frame.rows / 16)), 0, 0, cv::INTER_AREA);
+    if (reference.cols == current.cols && reference.rows == current.rows && reference.type() == current.type() &&
+        cv::norm(current, reference, cv::NORM_INF) <= threshold) {
+        return true;
+    }
+    cv::swap(current, reference);
+    return false;
+}
+
+void grayscaleFrame(const cv::Mat& input, cv::Mat& output) {
+    // Every output channel gets the BT.601 luma of the pixel (same weights as COLOR_BGR2GRAY), so the
+    // BGR frame the writer needs comes out of one vectorised pass instead of BGR->GRAY->BGR
+    static const cv::Matx33f lumaToBgr(0.114f, 0.587f, 0.299f,
+                                       0.114f, 0.587f, 0.299f,
+                                       0.114f, 0.587f, 0.299f);
+    cv::transform(input, output, lumaToBgr);
+}
+
+// Stretches limited-range luma (16-235, what YUV video carries) to the full 0-255 range gray frames use
+static void expandLimitedRange(const cv::Mat& limited, cv::Mat& full) {
+    limited.convertTo(full, CV_8U, 255.0 / 219.0, -16.0 * 255.0 / 219.0);
+}
+
+// Full-range luma of a frame the decoder returned without BGR conversion. Handles planar/semi-planar
+// 4:2:0 (one channel, 1.5x rows), a bare Y plane and packed YUYV. Limited-range luma is stretched into
+// luma, full-range 4:2:0 and Y planes are returned as a view into raw.
+static bool lumaFromRawFrame(const cv::Mat& raw, const cv::Size& frameSize, bool fullRange, cv::Mat& luma) {
+    if (raw.cols != frameSize.width) {
+        return false;
+    }
+    if (raw.channels() == 1 && (raw.rows == frameSize.height * 3 / 2 || raw.rows == frameSize.height)) {
+        if (fullRange) {
+            luma = raw.rowRange(0, frameSize.height);
+        } else {
+            expandLimitedRange(raw.rowRange(0, frameSize.height), luma);
+        }
+        return true;
+    }
+    if (raw.channels() == 2 && raw.rows == frameSize.height) {
+        cv::extractChannel(raw, luma, 0);
+        if (!fullRange) {
+            expandLimitedRange(luma, luma);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Range of the luma the decoder returns, read from the stream when libav is available. Otherwise only
+// MJPEG and gray sources are taken as full range.
+static bool sourceFullRange(cv::VideoCapture& cap, const std::string& inputPath) {
+    bool fullRange = false;
+    if (videoFullRange(inputPath, fullRange)) {
+        return fullRange;
+    }
+    int fourcc = static_cast<int>(cap.get(cv::CAP_PROP_FOURCC));
+    return fourcc == cv::VideoWriter::fourcc('M', 'J', 'P', 'G') || fourcc == cv::VideoWriter::fourcc('Y', '8', '0', '0') ||
+           fourcc == cv::VideoWriter::fourcc('G', 'R', 'E', 'Y');
+}
+
+// Turns off the backend's BGR conversion if its raw frames carry a usable luma plane, otherwise leaves
+// cap on the normal BGR path. cap is reopened either way so decoding starts from the first frame.
+static bool enableRawLuma(cv::VideoCapture& cap, const std::string& inputPath, const cv::Size& frameSize, bool fullRange) {
+    cv::Mat raw, luma;
+    bool usable = cap.set(cv::CAP_PROP_CONVERT_RGB, 0) && cap.read(raw) && lumaFromRawFrame(raw, frameSize, fullRange, luma);
+    cap.open(inputPath);
+    if (usable) {
+        cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
+    }
+    return usable;
+}
+
+BlurMethod chooseBlurMethod(int radius) {
+    if (radius <= 7) {
+        return BlurMethod::Gaussian;
+    }
+    if (radius <= 25) {
+        return BlurMethod::Box;
+    }
+    return BlurMethod::Downscaled;
+}
+
+// Sigma OpenCV derives for a (2 * radius + 1) kernel, so every method targets the same Gaussian
+static double blurSigma(int radius) {
+    return 0.3 * (radius - 1) + 0.8;
+}
+
+// Widths of three box filters whose repeated application approximates a Gaussian of the given sigma
+static void boxSizesForGaussian(double sigma, int sizes[3]) {
+    const int passes = 3;
+    double idealWidth = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lower = static_cast<int>(std::floor(idealWidth));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    int upper = lower + 2;
+    double idealLowerCount = (12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes) / (-4.0 * lower - 4.0);
+    int lowerCount = static_cast<int>(std::round(idealLowerCount));
+    for (int i = 0; i < passes; i++) {
+        sizes[i] = i < lowerCount ? lower : upper;
+    }
+}
+
+void blurFrame(const cv::Mat& input, cv::Mat& output, int radius, BlurMethod method) {
+    if (radius < 1) {
+        input.copyTo(output);
+        return;
+    }
+    if (method == BlurMethod::Auto) {
+        method = chooseBlurMethod(radius);
+    }
+
+    double sigma = blurSigma(radius);
+    switch (method) {
+        case BlurMethod::Box: {
+            // cv::blur keeps running sums, so each pass costs the same whatever the box width
+            int sizes[3];
+            boxSizesForGaussian(sigma, sizes);
+            cv::blur(input, output, cv::Size(sizes[0], sizes[0]));
+            cv::blur(output, output, cv::Size(sizes[1], sizes[1]));
+            cv::blur(output, output, cv::Size(sizes[2], sizes[2]));
+            break;
+        }
+        case BlurMethod::Downscaled: {
+            // Blur a copy reduced so the remaining radius is about 4 pixels, then scale it back up
+            int factor = std::max(2, radius / 4);
+            cv::Size smallSize(std::max(1, input.cols / factor), std::max(1, input.rows / factor));
+            int smallRadius = std::max(1, radius / factor);
+            thread_local cv::Mat small;
+            cv::resize(input, small, smallSize, 0, 0, cv::INTER_AREA);
+            cv::GaussianBlur(small, small, cv::Size(2 * smallRadius + 1, 2 * smallRadius + 1), sigma / factor);
+            cv::resize(small, output, input.size(), 0, 0, cv::INTER_LINEAR);
+            break;
+        }
+        default:
+            // GaussianBlur filters rows and columns separately, O(radius) per pixel
+            cv::GaussianBlur(input, output, cv::Size(2 * radius + 1, 2 * radius + 1), 0);
+            break;
+    }
+}
+
+bool trimFrameRange(double fps, int totalFrames, double startTime, double endTime, int& startFrame, int& endFrame) {
+    startFrame = static_cast<int>(startTime * fps);
+    endFrame = static_cast<int>(endTime * fps);
+    return !(startFrame >= totalFrames || endFrame >= totalFrames || startFrame >= endFrame);
+}
+
+bool seekToFrame(cv::VideoCapture& cap, int targetFrame) {
+    if (targetFrame <= 0) {
+        return true;
+    }
+
+    // The FFmpeg backend seeks to the nearest keyframe before the target and decodes forward to it
+    if (cap.set(cv::CAP_PROP_POS_FRAMES, targetFrame)) {
+        int position = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
+        if (position == targetFrame) {
+            return true;
+        }
+        std::cerr << "Warning: Seek landed on frame " << position << " instead of " << targetFrame << ", decoding forward." << std::endl;
+    }
+
+    // Frame-accurate fallback: rewind if we overshot, then decode forward to the target
+    int position = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
+    if (position > targetFrame) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+        position = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
+        if (position > targetFrame) {
+            return false;
+        }
+    }
+    while (position < targetFrame) {
+        if (!cap.grab()) {
+            return false;
+        }
+        position++;
+    }
+    return true;
+}
 
 //Resizing function
 void resizeVideo(const std::string& inputPath, const std::string& outputPath, int width, int height, int codec) {
     std::cout << "Preparing to resize video..." << std::endl;
 
+    // Scale while decoding so full-resolution BGR frames are never produced
+    ScaledDecoder decoder;
+    if (decoder.open(inputPath, cv::Size(width, height))) {
+        cv::VideoWriter writer(outputPath, codec, decoder.fps(), cv::Size(width, height));
+        if (!writer.isOpened()) {
+            std::cerr << "Error: Could not open output video file for resizing." << std::endl;
+            return;
+        }
+
+        std::cout << "Resizing video frames while decoding..." << std::endl;
+        cv::Mat frame;
+        int frameCount = 0;
+        while (decoder.read(frame)) {
+            writer.write(frame);
+            frameCount++;
+        }
+        std::cout << "Video resized successfully (" << frameCount << " frames). Output saved to " << outputPath << std::endl;
+        return;
+    }
+
     cv::VideoCapture cap(inputPath);
     if (!cap.isOpened()) {
         std::cerr << "Error: Could not open video file for resizing." << std::endl;
@@ -17,14 +300,14 @@ void resizeVideo(const std::string& inputPath, const std::string& outputPath, in
 
     std::cout << "Resizing video frames..." << std::endl;
     cv::Mat frame;
+    cv::Mat resizedFrame;
     int frameCount = 0;
     while (cap.read(frame)) {
-        cv::Mat resizedFrame;
-        cv::resize(frame, resizedFrame, cv::Size(width, height));
+        resizeFrame(frame, resizedFrame, width, height);
         writer.write(resizedFrame);
         frameCount++;
     }
-    std::cout << "Video resized successfully. Output saved to " << outputPath << std::endl;
+    std::cout << "Video resized successfully (" << frameCount << " frames). Output saved to " << outputPath << std::endl;
 }
 
 // Adding text function
@@ -49,14 +332,18 @@ void addTextOverlay(const std::string &inputPath, const std::string &outputPath,
     }
     std::cout << "Overlaying text on video frames..." << std::endl;
 
+    // The text is rendered once and only its rectangle is touched on each frame
+    OverlayCompositor overlays;
+    overlays.addText(text, x, y);
+
     cv::Mat frame;
     int frameCount = 0;
     while (cap.read(frame)) {
-        cv::putText(frame, text, cv::Point(x, y), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 3);
+        overlays.apply(frame, fps > 0 ? static_cast<double>(frameCount) / fps : 0.0);
         writer.write(frame);
         frameCount++;
     }
-    std::cout << "Text overlay applied successfully. Output saved to " << outputPath << std::endl;
+    std::cout << "Text overlay applied successfully (" << frameCount << " frames). Output saved to " << outputPath << std::endl;
 }
 
 // Trimming function
@@ -74,14 +361,18 @@ void trimVideo(const std::string& inputPath, const std::string& outputPath, doub
     int height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
     int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
 
-    int startFrame = static_cast<int>(startTime * fps);
-    int endFrame = static_cast<int>(endTime * fps);
-
-    if (startFrame >= totalFrames || endFrame >= totalFrames || startFrame >= endFrame) {
+    int startFrame, endFrame;
+    if (!trimFrameRange(fps, totalFrames, startTime, endTime, startFrame, endFrame)) {
         std::cerr << "Error: Invalid start or end time for trimming." << std::endl;
         return;
     }
 
+    // Copy the compressed packets when the source codec matches and the start is on a keyframe
+    if (canStreamCopy(inputPath, outputPath, codec) && streamCopyVideo(inputPath, outputPath, startFrame / fps, endFrame / fps)) {
+        std::cout << "Video trimmed without re-encoding. Output saved to " << outputPath << std::endl;
+        return;
+    }
+
     cv::VideoWriter writer(outputPath, codec, fps, cv::Size(width, height));
 
     if (!writer.isOpened()) {
@@ -91,24 +382,24 @@ void trimVideo(const std::string& inputPath, const std::string& outputPath, doub
 
     std::cout << "Trimming video from " << startTime << " to " << endTime << " seconds..." << std::endl;
 
-    cv::Mat frame;
-    int frameIndex = 0;
-    while (cap.read(frame)) {
-        if (frameIndex >= startFrame && frameIndex <= endFrame) {
-            writer.write(frame);
-        }
-
-        if (frameIndex > endFrame) {
-            break;
-        }
+    // Jump to the start instead of decoding everything before it
+    if (!seekToFrame(cap, startFrame)) {
+        std::cerr << "Error: Could not seek to the start of the trim window." << std::endl;
+        return;
+    }
 
+    cv::Mat frame;
+    int frameIndex = startFrame;
+    while (frameIndex <= endFrame && cap.read(frame)) {
+        writer.write(frame);
         frameIndex++;
     }
     std::cout << "Video trimmed successfully. Output saved to " << outputPath << std::endl;
 }
 // Rotating video
-void rotateVideo(const std::string& inputPath, const std::string& outputPath, int angle, int codec) {
+void rotateVideo(const std::string& inputPath, const std::string& outputPath, double angle, int codec, RotateFit fit) {
     std::cout << "Rotating video by " << angle << " degrees..." << std::endl;
+    angle = normalizeRotation(angle);
 
     cv::VideoCapture cap(inputPath);
     if (!cap.isOpened()) {
@@ -123,6 +414,13 @@ void rotateVideo(const std::string& inputPath, const std::string& outputPath, in
     // No rotation (0 or 360 degrees)
     if (angle == 0) {
         std::cout << "No rotation applied, copying video as-is..." << std::endl;
+
+        // Only the container changes, so copy the compressed packets when the codec allows it
+        if (canStreamCopy(inputPath, outputPath, codec) && streamCopyVideo(inputPath, outputPath, -1.0, -1.0)) {
+            std::cout << "Video copied without re-encoding. Output saved to " << outputPath << std::endl;
+            return;
+        }
+
         cv::VideoWriter writer(outputPath, codec, fps, cv::Size(width, height));
         if (!writer.isOpened()) {
             std::cerr << "Error: Could not open output video file for copying." << std::endl;
@@ -137,12 +435,19 @@ void rotateVideo(const std::string& inputPath, const std::string& outputPath, in
         return;
     }
 
-    // Swap width and height for 90 or 270 degree rotation
-    if (angle == 90 || angle == 270) {
-        std::swap(width, height);
+    // Right angles keep the cv::rotate path, any other angle samples through maps computed once for the video
+    bool rightAngle = std::fmod(angle, 90.0) == 0;
+    RotationMaps maps;
+    cv::Size outputSize(width, height);
+    if (!rightAngle) {
+        maps = buildRotationMaps(outputSize, angle, fit);
+        outputSize = maps.outputSize;
+    } else if (angle == 90 || angle == 270) {
+        // Swap width and height for 90 or 270 degree rotation
+        std::swap(outputSize.width, outputSize.height);
     }
 
-    cv::VideoWriter writer(outputPath, codec, fps, cv::Size(width, height));
+    cv::VideoWriter writer(outputPath, codec, fps, outputSize);
     if (!writer.isOpened()) {
         std::cerr << "Error: Could not open output video file for rotating." << std::endl;
         return;
@@ -151,21 +456,12 @@ void rotateVideo(const std::string& inputPath, const std::string& outputPath, in
     std::cout << "Applying " << angle << " degree rotation on video frames..." << std::endl;
 
     cv::Mat frame;
+    cv::Mat rotatedFrame;
     while (cap.read(frame)) {
-        cv::Mat rotatedFrame;
-        switch (angle) {
-            case 90:
-                cv::rotate(frame, rotatedFrame, cv::ROTATE_90_CLOCKWISE);
-                break;
-            case 180:
-                cv::rotate(frame, rotatedFrame, cv::ROTATE_180);
-                break;
-            case 270:
-                cv::rotate(frame, rotatedFrame, cv::ROTATE_90_COUNTERCLOCKWISE);
-                break;
-            default:
-                std::cerr << "Error: Invalid rotation angle." << std::endl;
-                return;
+        if (rightAngle) {
+            rotateFrame(frame, rotatedFrame, static_cast<int>(angle));
+        } else {
+            rotateFrameWithMaps(frame, rotatedFrame, maps);
         }
         writer.write(rotatedFrame);
     }
@@ -187,29 +483,55 @@ void applyGrayscale(const std::string& inputPath, const std::string& outputPath,
     int width = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
     int height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
 
-    cv::VideoWriter writer(outputPath, codec, fps, cv::Size(width, height));
+    // Hand single-channel frames to the encoder when the writer accepts them (isColor = false)
+    cv::VideoWriter writer(outputPath, codec, fps, cv::Size(width, height), false);
+    bool grayWriter = writer.isOpened();
+    if (!grayWriter) {
+        writer.open(outputPath, codec, fps, cv::Size(width, height), true);
+    }
 
     if (!writer.isOpened()) {
         std::cerr << "Error: Could not open output video file for grayscale filter." << std::endl;
         return;
     }
 
+    bool fullRange = sourceFullRange(cap, inputPath);
+    bool rawLuma = enableRawLuma(cap, inputPath, cv::Size(width, height), fullRange);
+    if (!cap.isOpened()) {
+        std::cerr << "Error: Could not open video file for grayscale filter." << std::endl;
+        return;
+    }
+
     std::cout << "Converting video frames to grayscale..." << std::endl;
 
     cv::Mat frame;
+    cv::Mat luma;
+    cv::Mat grayFrame;
     int frameCount = 0;
     while (cap.read(frame)) {
-        cv::Mat grayFrame;
-        cv::cvtColor(frame, grayFrame, cv::COLOR_BGR2GRAY);
-        cv::cvtColor(grayFrame, grayFrame, cv::COLOR_GRAY2BGR);  // Convert back to BGR for writer
-        writer.write(grayFrame);
+        if (rawLuma) {
+            // Luma comes straight from the decoder's Y plane, no colour conversion at all
+            lumaFromRawFrame(frame, cv::Size(width, height), fullRange, luma);
+            if (grayWriter) {
+                writer.write(luma);
+            } else {
+                cv::cvtColor(luma, grayFrame, cv::COLOR_GRAY2BGR);
+                writer.write(grayFrame);
+            }
+        } else if (grayWriter) {
+            cv::cvtColor(frame, luma, cv::COLOR_BGR2GRAY);
+            writer.write(luma);
+        } else {
+            grayscaleFrame(frame, grayFrame);
+            writer.write(grayFrame);
+        }
         frameCount++;
     }
-    std::cout << "Grayscale filter applied successfully. Output saved to " << outputPath << std::endl;
+    std::cout << "Grayscale filter applied successfully (" << frameCount << " frames). Output saved to " << outputPath << std::endl;
 }
 
 // Applying blur function
-void applyBlur(const std::string& inputPath, const std::string& outputPath, int codec) {
+void applyBlur(const std::string& inputPath, const std::string& outputPath, int codec, int radius, BlurMethod method) {
     std::cout << "Applying blur filter..." << std::endl;
 
     cv::VideoCapture cap(inputPath);
@@ -232,12 +554,12 @@ void applyBlur(const std::string& inputPath, const std::string& outputPath, int
     std::cout << "Blurring video frames..." << std::endl;
 
     cv::Mat frame;
+    cv::Mat blurredFrame;
     int frameCount = 0;
     while (cap.read(frame)) {
-        cv::Mat blurredFrame;
-        cv::GaussianBlur(frame, blurredFrame, cv::Size(15, 15), 0);
+        blurFrame(frame, blurredFrame, radius, method);
         writer.write(blurredFrame);
         frameCount++;
     }
-    std::cout << "Blur filter applied successfully. Output saved to " << outputPath << std::endl;
+    std::cout << "Blur filter applied successfully (" << frameCount << " frames). Output saved to " << outputPath << std::endl;
 }
\ No newline at end of file
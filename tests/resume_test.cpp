@@ -0,0 +1,212 @@
+// Kills a checkpointed job after a few segments, resumes it and checks that the result matches an
+// uninterrupted run frame for frame, has every source frame and lines up with a plain runPipeline output at
+// the segment boundaries. Exit code 0 on success.
+// Usage: ./ResumeTest [work directory]
+#include "batch_runner.h"
+#include "libav_io.h"
+#include "segment_processing.h"
+#include <opencv2/opencv.hpp>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+
+// Deterministic clip: a moving gradient with a bouncing box, distinct in every frame
+static bool generateVideo(const std::string& path, int frameCount) {
+    cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30.0, cv::Size(640, 360));
+    if (!writer.isOpened()) {
+        return false;
+    }
+    cv::Mat frame(360, 640, CV_8UC3);
+    for (int i = 0; i < frameCount; i++) {
+        for (int y = 0; y < frame.rows; y++) {
+            cv::Vec3b* row = frame.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < frame.cols; x++) {
+                row[x][0] = static_cast<uchar>((x + 3 * i) & 0xFF);
+                row[x][1] = static_cast<uchar>(y & 0xFF);
+                row[x][2] = static_cast<uchar>(i & 0xFF);
+            }
+        }
+        cv::rectangle(frame, cv::Rect((i * 9) % 560, (i * 5) % 280, 80, 80), cv::Scalar(255, 255, 255), cv::FILLED);
+        writer.write(frame);
+    }
+    return true;
+}
+
+static int finishedSegments(const std::string& checkpointPath) {
+    std::ifstream checkpoint(checkpointPath);
+    std::string line;
+    int done = 0;
+    while (std::getline(checkpoint, line)) {
+        done += line.rfind("done ", 0) == 0 ? 1 : 0;
+    }
+    return done;
+}
+
+static bool sameFrames(const std::string& firstPath, const std::string& secondPath, int& frames) {
+    cv::VideoCapture first(firstPath);
+    cv::VideoCapture second(secondPath);
+    if (!first.isOpened() || !second.isOpened()) {
+        return false;
+    }
+    cv::Mat a, b;
+    frames = 0;
+    while (true) {
+        bool hasFirst = first.read(a);
+        bool hasSecond = second.read(b);
+        if (hasFirst != hasSecond) {
+            return false;
+        }
+        if (!hasFirst) {
+            return frames > 0;
+        }
+        if (a.size() != b.size() || cv::norm(a, b, cv::NORM_INF) != 0) {
+            return false;
+        }
+        frames++;
+    }
+}
+
+// Counts the frames of a video and keeps the ones listed in wanted
+static bool readFrames(const std::string& path, const std::set<int>& wanted, std::map<int, cv::Mat>& frames, int& count) {
+    cv::VideoCapture cap(path);
+    if (!cap.isOpened()) {
+        return false;
+    }
+    cv::Mat frame;
+    for (count = 0; cap.read(frame); count++) {
+        if (wanted.count(count)) {
+            frames[count] = frame.clone();
+        }
+    }
+    return true;
+}
+
+// The segmented output re-encodes frames when segments cannot be joined by copying packets, so instead of
+// exact equality each frame next to a boundary has to be closer to the plain run's frame at the same index
+// than to its neighbours. A frame dropped or repeated at the boundary shifts that match.
+static bool boundariesAligned(const std::string& segmentedPath, const std::string& plainPath, const std::vector<FrameRange>& segments,
+                              std::string& error) {
+    std::set<int> checked, wanted;
+    for (size_t i = 1; i < segments.size(); i++) {
+        for (int frame = segments[i].start - 1; frame <= segments[i].start; frame++) {
+            checked.insert(frame);
+            wanted.insert({frame - 1, frame, frame + 1});
+        }
+    }
+    std::map<int, cv::Mat> segmented, plain;
+    int segmentedCount = 0, plainCount = 0;
+    if (!readFrames(segmentedPath, checked, segmented, segmentedCount) || !readFrames(plainPath, wanted, plain, plainCount)) {
+        error = "could not read the outputs";
+        return false;
+    }
+    if (segmentedCount != plainCount) {
+        error = "plain run has " + std::to_string(plainCount) + " frames, segmented run " + std::to_string(segmentedCount);
+        return false;
+    }
+    for (int frame : checked) {
+        double same = cv::norm(segmented[frame], plain[frame], cv::NORM_L1);
+        if (same >= cv::norm(segmented[frame], plain[frame - 1], cv::NORM_L1) ||
+            same >= cv::norm(segmented[frame], plain[frame + 1], cv::NORM_L1)) {
+            error = "frame " + std::to_string(frame) + " at a segment boundary does not match the plain run";
+            return false;
+        }
+    }
+    return true;
+}
+
+static int fail(const std::string& message) {
+    std::cerr << "FAIL: " << message << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string workDir = argc > 1 ? argv[1] : "resume_test";
+    mkdir(workDir.c_str(), 0777);
+    std::string inputPath = workDir + "/input.avi";
+    std::string resumedPath = workDir + "/resumed.avi";
+    std::string referencePath = workDir + "/reference.avi";
+    std::string plainPath = workDir + "/plain.avi";
+    std::string checkpointPath = resumeDirectory(resumedPath) + "/checkpoint";
+    std::filesystem::remove_all(resumeDirectory(resumedPath));
+    std::remove(resumedPath.c_str());
+
+    const int frameCount = 600;
+    if (!generateVideo(inputPath, frameCount)) {
+        return fail("could not generate " + inputPath);
+    }
+
+    JobSpec job;
+    std::string error;
+    if (!makeJob(inputPath, resumedPath, "text=20,40,Resume;blur=15;grayscale", job, error)) {
+        return fail(error);
+    }
+    ResumeOptions resume;
+    resume.checkpointSeconds = 0.5;  // 40 segments of 15 frames
+    resume.signature = job.operations;
+    resume.pipeline.verbose = false;
+
+    // The job runs in a child that is killed without warning once a few segments are checkpointed
+    pid_t child = fork();
+    if (child == 0) {
+        std::_Exit(runPipelineResumable(inputPath, resumedPath, job.pipeline, job.codec, resume) ? 0 : 1);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(120);
+    while (finishedSegments(checkpointPath) < 3 && std::chrono::steady_clock::now() < deadline) {
+        if (waitpid(child, nullptr, WNOHANG) == child) {
+            return fail("the job finished before it could be killed");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+
+    int checkpointed = finishedSegments(checkpointPath);
+    if (checkpointed < 3 || std::filesystem::exists(resumedPath)) {
+        return fail("expected a partial run, got " + std::to_string(checkpointed) + " checkpointed segment(s)");
+    }
+    std::cout << "Killed after " << checkpointed << " checkpointed segment(s), resuming" << std::endl;
+
+    if (!runPipelineResumable(inputPath, resumedPath, job.pipeline, job.codec, resume)) {
+        return fail("resumed run failed");
+    }
+    if (std::filesystem::exists(resumeDirectory(resumedPath))) {
+        return fail("work directory left behind after a complete run");
+    }
+
+    // Same segments without the interruption
+    if (!runPipelineResumable(inputPath, referencePath, job.pipeline, job.codec, resume)) {
+        return fail("uninterrupted run failed");
+    }
+
+    int frames = 0;
+    if (!sameFrames(resumedPath, referencePath, frames)) {
+        return fail("resumed output differs from the uninterrupted run");
+    }
+    if (frames != frameCount) {
+        return fail("resumed output has " + std::to_string(frames) + " frames, the input has " + std::to_string(frameCount));
+    }
+
+    // Both runs above share the segment plan, a plain run of the same chain checks the plan itself
+    PipelineOptions plainOptions;
+    plainOptions.verbose = false;
+    if (!runPipeline(inputPath, plainPath, job.pipeline, job.codec, plainOptions)) {
+        return fail("plain run failed");
+    }
+    std::vector<FrameRange> segments = planSegments(0, frameCount - 1, frameCount / 15, buildKeyframeIndex(inputPath));
+    if (!boundariesAligned(resumedPath, plainPath, segments, error)) {
+        return fail(error);
+    }
+    std::cout << "PASS: resumed output matches the uninterrupted run (" << frames << " frames) and the plain run at "
+              << segments.size() - 1 << " segment boundaries" << std::endl;
+    return 0;
+}
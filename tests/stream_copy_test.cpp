@@ -0,0 +1,209 @@
+// Encodes an H.264 clip with B-frames, stream-copies trims that end on and between keyframes and checks that
+// every frame of the output decodes to exactly the source frame. Exit code 0 on success, 77 when no H.264
+// encoder producing B-frames is available.
+// Usage: ./StreamCopyTest [work directory]
+#include "libav_io.h"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+}
+
+static const int frameCount = 120;
+static const int frameRate = 30;
+
+// Writes packets the encoder has ready, all remaining ones once it has been flushed
+static bool drainEncoder(AVCodecContext* encoder, AVFormatContext* output, AVStream* stream) {
+    AVPacket* packet = av_packet_alloc();
+    bool ok = true;
+    while (avcodec_receive_packet(encoder, packet) >= 0) {
+        av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        ok = ok && av_interleaved_write_frame(output, packet) >= 0;
+    }
+    av_packet_free(&packet);
+    return ok;
+}
+
+// Deterministic 320x240 clip: a moving gradient, so P- and B-frames carry real residuals
+static bool generateVideo(const std::string& path) {
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    AVFormatContext* output = nullptr;
+    if (!codec || avformat_alloc_output_context2(&output, nullptr, nullptr, path.c_str()) < 0) {
+        return false;
+    }
+    AVStream* stream = avformat_new_stream(output, nullptr);
+    AVCodecContext* encoder = avcodec_alloc_context3(codec);
+    encoder->width = 320;
+    encoder->height = 240;
+    encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+    encoder->time_base = AVRational{1, frameRate};
+    encoder->framerate = AVRational{frameRate, 1};
+    encoder->gop_size = 30;
+    encoder->keyint_min = 30;
+    encoder->max_b_frames = 2;
+    if (output->oformat->flags & AVFMT_GLOBALHEADER) {
+        encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    bool ok = avcodec_open2(encoder, codec, nullptr) >= 0 && avcodec_parameters_from_context(stream->codecpar, encoder) >= 0 &&
+              avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE) >= 0;
+    stream->time_base = encoder->time_base;
+    ok = ok && avformat_write_header(output, nullptr) >= 0;
+
+    AVFrame* frame = av_frame_alloc();
+    frame->format = encoder->pix_fmt;
+    frame->width = encoder->width;
+    frame->height = encoder->height;
+    ok = ok && av_frame_get_buffer(frame, 0) >= 0;
+    for (int i = 0; ok && i < frameCount; i++) {
+        ok = av_frame_make_writable(frame) >= 0;
+        for (int plane = 0; ok && plane < 3; plane++) {
+            int width = plane == 0 ? frame->width : frame->width / 2;
+            int height = plane == 0 ? frame->height : frame->height / 2;
+            for (int y = 0; y < height; y++) {
+                uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+                for (int x = 0; x < width; x++) {
+                    row[x] = static_cast<uint8_t>(plane == 0 ? x + 2 * y + 3 * i : 128 + plane * i + x / 4);
+                }
+            }
+        }
+        frame->pts = i;
+        ok = ok && avcodec_send_frame(encoder, frame) >= 0 && drainEncoder(encoder, output, stream);
+    }
+    ok = ok && avcodec_send_frame(encoder, nullptr) >= 0 && drainEncoder(encoder, output, stream);
+    ok = ok && av_write_trailer(output) >= 0;
+
+    av_frame_free(&frame);
+    avcodec_free_context(&encoder);
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+    return ok;
+}
+
+// Decodes every frame's luma plane. False if the file cannot be decoded or any frame is flagged corrupt.
+static bool decodeFrames(const std::string& path, std::vector<std::vector<uint8_t>>& frames, int* videoDelay = nullptr) {
+    frames.clear();
+    AVFormatContext* input = nullptr;
+    if (avformat_open_input(&input, path.c_str(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    int streamIndex = avformat_find_stream_info(input, nullptr) >= 0 ? av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0) : -1;
+    if (streamIndex < 0) {
+        avformat_close_input(&input);
+        return false;
+    }
+    const AVCodecParameters* parameters = input->streams[streamIndex]->codecpar;
+    if (videoDelay) {
+        *videoDelay = parameters->video_delay;
+    }
+    const AVCodec* codec = avcodec_find_decoder(parameters->codec_id);
+    AVCodecContext* decoder = avcodec_alloc_context3(codec);
+    bool ok = codec && avcodec_parameters_to_context(decoder, parameters) >= 0 && avcodec_open2(decoder, codec, nullptr) >= 0;
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    bool draining = false;
+    while (ok && !draining) {
+        int read = av_read_frame(input, packet);
+        if (read >= 0 && packet->stream_index != streamIndex) {
+            av_packet_unref(packet);
+            continue;
+        }
+        draining = read < 0;
+        ok = avcodec_send_packet(decoder, draining ? nullptr : packet) >= 0;
+        av_packet_unref(packet);
+        while (ok && avcodec_receive_frame(decoder, frame) >= 0) {
+            ok = frame->decode_error_flags == 0 && !(frame->flags & AV_FRAME_FLAG_CORRUPT);
+            std::vector<uint8_t> luma(static_cast<size_t>(frame->width) * frame->height);
+            for (int y = 0; y < frame->height; y++) {
+                std::memcpy(&luma[static_cast<size_t>(y) * frame->width], frame->data[0] + y * frame->linesize[0], frame->width);
+            }
+            frames.push_back(luma);
+            av_frame_unref(frame);
+        }
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&input);
+    return ok;
+}
+
+static int fail(const std::string& message) {
+    std::cerr << "FAIL: " << message << std::endl;
+    return 1;
+}
+
+// Stream-copies frames 0..endFrame. A copy that is refused is fine, one that is written has to decode
+// completely and match the source frame for frame.
+static bool checkTrim(const std::string& inputPath, const std::string& outputPath, const std::vector<std::vector<uint8_t>>& source,
+                      int endFrame, bool mustCopy, std::string& error) {
+    std::remove(outputPath.c_str());
+    if (!streamCopyVideo(inputPath, outputPath, 0.0, static_cast<double>(endFrame) / frameRate)) {
+        error = mustCopy ? "stream copy refused a trim ending before a keyframe" : "";
+        return !mustCopy;
+    }
+    std::vector<std::vector<uint8_t>> trimmed;
+    if (!decodeFrames(outputPath, trimmed)) {
+        error = "trim to frame " + std::to_string(endFrame) + " has frames that do not decode";
+        return false;
+    }
+    if (static_cast<int>(trimmed.size()) != endFrame + 1) {
+        error = "trim to frame " + std::to_string(endFrame) + " has " + std::to_string(trimmed.size()) + " frames";
+        return false;
+    }
+    for (size_t i = 0; i < trimmed.size(); i++) {
+        if (trimmed[i] != source[i]) {
+            error = "trim to frame " + std::to_string(endFrame) + " differs from the source at frame " + std::to_string(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string workDir = argc > 1 ? argv[1] : "stream_copy_test";
+    mkdir(workDir.c_str(), 0777);
+    std::string inputPath = workDir + "/input.mp4";
+    std::string outputPath = workDir + "/trimmed.mp4";
+
+    std::vector<std::vector<uint8_t>> source;
+    int videoDelay = 0;
+    if (!generateVideo(inputPath) || !decodeFrames(inputPath, source, &videoDelay) || videoDelay == 0) {
+        std::cout << "SKIP: no H.264 encoder with B-frames available" << std::endl;
+        return 77;
+    }
+    if (static_cast<int>(source.size()) != frameCount) {
+        return fail("source decodes to " + std::to_string(source.size()) + " frames");
+    }
+
+    std::vector<int> keyframes = buildKeyframeIndex(inputPath);
+    if (keyframes.size() < 2) {
+        return fail("expected several keyframes in the source");
+    }
+
+    std::string error;
+    // Ending right before a keyframe is a clean cut and has to be copied
+    if (!checkTrim(inputPath, outputPath, source, keyframes[1] - 1, true, error)) {
+        return fail(error);
+    }
+    // Every other end inside the second GOP leaves frames that reference packets past the cut
+    int gopEnd = keyframes.size() > 2 ? keyframes[2] - 1 : frameCount - 1;
+    for (int endFrame = keyframes[1]; endFrame < gopEnd; endFrame++) {
+        if (!checkTrim(inputPath, outputPath, source, endFrame, false, error)) {
+            return fail(error);
+        }
+    }
+    std::remove(outputPath.c_str());
+    std::cout << "PASS: every stream-copied trim decodes to the source frames" << std::endl;
+    return 0;
+}